@@ -0,0 +1,98 @@
+#pragma once
+
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+
+#include "arena.h"
+
+// Counts calls to the global operator new, so the frame loop can check that it no longer allocates
+// once it is running. Build with -DLANDINGPAD_ALLOC_CHECK to enable it; include this header in the
+// file with main only, as it replaces the global operators. malloc from C code, the GL driver for
+// one, is not seen. Arena blocks come from malloc too, a scope given the frame arena checks that
+// it took no new block.
+//
+//  alloc_check::Scope steady(frame > 0, &frameArena);   fails when the scope ends if anything was allocated
+
+#ifdef LANDINGPAD_ALLOC_CHECK
+
+#include <atomic>
+#include <new>
+
+namespace alloc_check{
+    std::atomic<uint64_t> allocations{0};
+
+    uint64_t count(){
+        return allocations.load(std::memory_order_relaxed);
+    }
+
+    class Scope{
+    public:
+        Scope(bool armed = true, const Arena *arena = nullptr)
+            : armed(armed), start(count()), arena(arena), arenaStart(arena ? arena->grown() : 0){}
+        ~Scope(){
+            if(!this->armed){
+                return;
+            }
+            uint64_t n = count()-this->start;
+            if(n > 0){
+                fprintf(stderr,"alloc_check: %llu allocations in a steady state scope\n",(unsigned long long)n);
+                std::abort();
+            }
+            uint64_t blocks = this->arena ? this->arena->grown()-this->arenaStart : 0;
+            if(blocks > 0){
+                fprintf(stderr,"alloc_check: the arena took %llu blocks in a steady state scope\n",(unsigned long long)blocks);
+                std::abort();
+            }
+        }
+    private:
+        bool armed;
+        uint64_t start;
+        const Arena *arena;
+        uint64_t arenaStart;
+    };
+}
+
+void *operator new(size_t size){
+    alloc_check::allocations.fetch_add(1,std::memory_order_relaxed);
+    if(void *p = std::malloc(size ? size : 1)){
+        return p;
+    }
+    throw std::bad_alloc();
+}
+void *operator new[](size_t size){
+    return operator new(size);
+}
+void *operator new(size_t size, const std::nothrow_t&) noexcept{
+    alloc_check::allocations.fetch_add(1,std::memory_order_relaxed);
+    return std::malloc(size ? size : 1);
+}
+void *operator new[](size_t size, const std::nothrow_t &tag) noexcept{
+    return operator new(size,tag);
+}
+void operator delete(void *p) noexcept{
+    std::free(p);
+}
+void operator delete[](void *p) noexcept{
+    std::free(p);
+}
+void operator delete(void *p, size_t) noexcept{
+    std::free(p);
+}
+void operator delete[](void *p, size_t) noexcept{
+    std::free(p);
+}
+
+#else
+
+namespace alloc_check{
+    uint64_t count(){
+        return 0;
+    }
+    class Scope{
+    public:
+        Scope(bool = true, const Arena* = nullptr){}
+    };
+}
+
+#endif
@@ -0,0 +1,153 @@
+#pragma once
+
+#include <cstdint>
+#include <algorithm>
+#include <vector>
+
+#include "image.h"
+#include "mask.h"
+#include "simd.h"
+#include "classify.h"
+#include "bounds.h"
+#include "conic.h"
+#include "yuv.h"
+#include "thread_pool.h"
+#include "profiler.h"
+
+// Splits a window of the frame into row bands that are analysed in parallel. Each band writes
+// only its own rows and its own partial result, which are merged in band order afterwards.
+namespace analysis{
+    struct result{
+        bool found = false;
+        bounds::box extent;
+        uint32_t borderCount = 0, padCount = 0;
+        // Outer left and right edge of the border in each row, top to bottom
+        std::vector<conic::sample> samples;
+    };
+
+    class Analyzer{
+    public:
+        ThreadPool *pool;
+        Analyzer(ThreadPool *pool = nullptr){
+            this->pool = pool;
+            this->bands.resize(RowBands::most(pool));
+        }
+        // With masks, the window is classified into them and pixels are counted. Without, only the
+        // border ends of each row are searched for, starting from the window edges.
+        void run(const rgba *pixels, uint32_t stride, const bounds::box &window, const simd::ColorRange &borderRange, const simd::ColorRange &padRange, ColorMask *border, ColorMask *pad, result &res){
+            this->analyze(rgbaSource{pixels,stride,borderRange,padRange},window,border,pad,res);
+        }
+        // The same for a YUV frame. The window is widened to start on an even column, where chroma
+        // pairs start.
+        void run(const yuv::Frame &frame, const bounds::box &window, const yuv::Range &borderRange, const yuv::Range &padRange, ColorMask *border, ColorMask *pad, result &res){
+            bounds::box even = {{window.min.x & ~1u,window.min.y},window.max};
+            this->analyze(yuv::Source{frame,borderRange,padRange},even,border,pad,res);
+        }
+    private:
+        struct rgbaSource{
+            const rgba *pixels;
+            uint32_t stride;
+            const simd::ColorRange &borderRange, &padRange;
+
+            void classify(uint32_t y, uint32_t begin, uint32_t end, uint64_t *b, uint64_t *p) const {
+                classify::row(this->pixels+y*this->stride+begin,end-begin,this->borderRange,this->padRange,b,p);
+            }
+            uint32_t first(uint32_t y, uint32_t begin, uint32_t end) const {
+                return simd::firstMatch(this->pixels+y*this->stride,begin,end,this->borderRange);
+            }
+            uint32_t last(uint32_t y, uint32_t begin, uint32_t end) const {
+                return simd::lastMatch(this->pixels+y*this->stride,begin,end,this->borderRange);
+            }
+        };
+        // What a band found, its samples are in the result already
+        struct partial{
+            bool found;
+            bounds::box extent;
+            uint32_t borderCount, padCount;
+            size_t samples;
+        };
+        std::vector<partial> bands;
+
+        template<typename Source>
+        void analyze(const Source &source, const bounds::box &window, ColorMask *border, ColorMask *pad, result &res){
+            PROFILE_SCOPE(ANALYSIS);
+            uint32_t width = window.max.x-window.min.x+1, height = window.max.y-window.min.y+1;
+            if(border){
+                border->resize(window.min.x,window.min.y,width,height);
+                pad->resize(window.min.x,window.min.y,width,height);
+            }
+            RowBands rows(this->pool,height);
+            // Every row has room for its two samples, so bands write straight into res without
+            // sharing anything and the gaps are closed up afterwards
+            res.samples.resize(2*height);
+            rows.run([&](uint32_t i, uint32_t y0, uint32_t y1){
+                analyzeBand(source,window,window.min.y+y0,window.min.y+y1,border,pad,res.samples.data()+2*y0,this->bands[i]);
+            });
+
+            res.found = false;
+            res.borderCount = 0;
+            res.padCount = 0;
+            size_t count = 0;
+            for(uint32_t i=0;i<rows.size();++i){
+                const partial &part = this->bands[i];
+                res.borderCount += part.borderCount;
+                res.padCount += part.padCount;
+                const conic::sample *first = res.samples.data()+2*rows.begin(i);
+                if(first != res.samples.data()+count){
+                    std::copy(first,first+part.samples,res.samples.data()+count);
+                }
+                count += part.samples;
+                if(!part.found){
+                    continue;
+                }
+                if(!res.found){
+                    res.extent = part.extent;
+                    res.found = true;
+                }else{
+                    res.extent.min = {std::min(res.extent.min.x,part.extent.min.x),std::min(res.extent.min.y,part.extent.min.y)};
+                    res.extent.max = {std::max(res.extent.max.x,part.extent.max.x),std::max(res.extent.max.y,part.extent.max.y)};
+                }
+            }
+            res.samples.resize(count);
+        }
+        template<typename Source>
+        static void analyzeBand(const Source &source, const bounds::box &window, uint32_t y0, uint32_t y1, ColorMask *border, ColorMask *pad, conic::sample *samples, partial &res){
+            res.found = false;
+            res.borderCount = 0;
+            res.padCount = 0;
+            res.samples = 0;
+            uint32_t begin = window.min.x, end = window.max.x+1;
+            for(uint32_t y=y0;y<y1;++y){
+                uint32_t first, last;
+                if(border){
+                    source.classify(y,begin,end,border->row(y),pad->row(y));
+                    for(uint32_t k=0;k<border->stride;++k){
+                        res.borderCount += __builtin_popcountll(border->row(y)[k]);
+                        res.padCount += __builtin_popcountll(pad->row(y)[k]);
+                    }
+                    first = border->find(y,begin,end,true);
+                    if(first == end){
+                        continue;
+                    }
+                    last = border->rfind(y,first,end,true);
+                }else{
+                    first = source.first(y,begin,end);
+                    if(first == end){
+                        continue;
+                    }
+                    last = source.last(y,first,end);
+                }
+                // Samples sit on the outer pixel edges
+                samples[res.samples++] = {(double)first,y+0.5};
+                samples[res.samples++] = {last+1.0,y+0.5};
+                if(!res.found){
+                    res.extent = {{first,y},{last,y}};
+                    res.found = true;
+                }else{
+                    res.extent.min.x = std::min(res.extent.min.x,first);
+                    res.extent.max = {std::max(res.extent.max.x,last),y};
+                }
+            }
+        }
+    };
+}
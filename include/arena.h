@@ -0,0 +1,152 @@
+#pragma once
+
+#include <cstdint>
+#include <cstddef>
+#include <cstdlib>
+#include <algorithm>
+#include <new>
+
+// Bump allocator for scratch memory that only lives for one frame. Allocating moves a pointer,
+// reset() hands everything back at once. Nothing is constructed or destroyed, so only trivial types
+// belong in here.
+//
+// A frame that needs more than the block holds continues in extra blocks. The next reset() replaces
+// them all with one block big enough for that frame, so once the largest frame has been seen the
+// arena stops touching the heap. grown() counts the blocks taken. They come from malloc, which
+// alloc_check does not count, so alloc_check::Scope checks grown() when given the arena.
+class Arena{
+public:
+    // Every allocation starts on its own cache line
+    static constexpr size_t ALIGN = 64;
+
+    Arena(size_t capacity = 0){
+        this->reserve(capacity);
+    }
+    Arena(const Arena&) = delete;
+    Arena &operator=(const Arena&) = delete;
+    ~Arena(){
+        this->release();
+        std::free(this->main.raw);
+    }
+    // Uninitialized room for count values of T
+    template<typename T>
+    T *allocate(size_t count){
+        static_assert(alignof(T) <= ALIGN);
+        return (T*)this->allocate(count*sizeof(T));
+    }
+    void *allocate(size_t bytes){
+        bytes = (bytes + ALIGN-1) & ~(ALIGN-1);
+        if(bytes > (size_t)(this->end-this->top)){
+            this->spill(bytes);
+        }
+        void *res = this->top;
+        this->top += bytes;
+        this->peak = std::max(this->peak,this->used());
+        return res;
+    }
+    // Frees everything allocated since the last reset
+    void reset(){
+        if(this->extras > 0 || this->wanted > this->capacity()){
+            this->release();
+            this->grow(std::max(this->peak,this->wanted));
+        }
+        this->top = this->main.data;
+        this->end = this->main.data + this->main.size;
+        this->spilled = 0;
+    }
+    // Makes sure a frame of at least bytes fits in one block. Takes effect right away if the arena
+    // is empty, otherwise at the next reset.
+    void reserve(size_t bytes){
+        this->wanted = std::max(this->wanted,bytes);
+        if(this->used() == 0 && bytes > this->capacity()){
+            this->reset();
+        }
+    }
+    // Bytes handed out since the last reset
+    size_t used() const {
+        const Block &current = this->extras > 0 ? this->extra[this->extras-1] : this->main;
+        return this->spilled + (this->top-current.data);
+    }
+    size_t capacity() const {
+        return this->main.size;
+    }
+    // Times a block had to be allocated
+    uint64_t grown() const {
+        return this->growths;
+    }
+private:
+    struct Block{
+        void *raw = nullptr;
+        uint8_t *data = nullptr;
+        size_t size = 0;
+    };
+    // Extra blocks double in size, so this many cover any frame that fits in memory
+    static constexpr int MAX_EXTRA = 32;
+
+    Block main;
+    // Blocks taken during this frame because the main one was full
+    Block extra[MAX_EXTRA];
+    int extras = 0;
+    uint8_t *top = nullptr, *end = nullptr;
+    // Bytes used in blocks that were left during this frame
+    size_t spilled = 0;
+    size_t peak = 0, wanted = 0;
+    uint64_t growths = 0;
+
+    Block allocateBlock(size_t bytes){
+        Block res;
+        res.raw = std::malloc(bytes + ALIGN);
+        if(!res.raw){
+            throw std::bad_alloc();
+        }
+        res.data = (uint8_t*)(((uintptr_t)res.raw + ALIGN-1) & ~(uintptr_t)(ALIGN-1));
+        res.size = bytes;
+        ++this->growths;
+        return res;
+    }
+    void grow(size_t bytes){
+        std::free(this->main.raw);
+        this->main = Block();
+        this->main = this->allocateBlock((bytes + ALIGN-1) & ~(ALIGN-1));
+    }
+    void spill(size_t bytes){
+        if(this->extras == MAX_EXTRA){
+            throw std::bad_alloc();
+        }
+        const Block &current = this->extras > 0 ? this->extra[this->extras-1] : this->main;
+        size_t size = std::max(bytes,std::max<size_t>(2*current.size,1 << 16));
+        this->spilled += this->top-current.data;
+        this->extra[this->extras] = this->allocateBlock(size);
+        this->top = this->extra[this->extras].data;
+        this->end = this->top + size;
+        ++this->extras;
+    }
+    void release(){
+        for(int i=0;i<this->extras;++i){
+            std::free(this->extra[i].raw);
+        }
+        this->extras = 0;
+    }
+};
+
+// Array allocated from an Arena, valid until the arena is reset
+template<typename T>
+struct ArenaArray{
+    T *data = nullptr;
+    size_t count = 0;
+    T *begin() const {
+        return this->data;
+    }
+    T *end() const {
+        return this->data + this->count;
+    }
+    size_t size() const {
+        return this->count;
+    }
+    bool empty() const {
+        return this->count == 0;
+    }
+    T &operator[](size_t i) const {
+        return this->data[i];
+    }
+};
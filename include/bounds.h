@@ -0,0 +1,104 @@
+#pragma once
+
+#include <cstdint>
+#include <algorithm>
+
+#include "image.h"
+#include "simd.h"
+#include "mask.h"
+
+namespace bounds{
+    // Inclusive pixel extents
+    struct box{
+        point min, max;
+    };
+
+    // Extents of every pixel inside the range, in one row-major pass.
+    // The first and last matching rows are found from the outside in, and rows between them
+    // only look at the columns left of the current minimum and right of the current maximum.
+    bool find(const rgba *pixels, uint32_t width, uint32_t height, uint32_t stride, const simd::ColorRange &range, box &res){
+        uint32_t minY = 0;
+        uint32_t first = width;
+        for(;minY<height;++minY){
+            first = simd::firstMatch(pixels+minY*stride,0,width,range);
+            if(first < width){
+                break;
+            }
+        }
+        if(minY == height){
+            return false;
+        }
+        uint32_t minX = first;
+        uint32_t maxX = simd::lastMatch(pixels+minY*stride,first,width,range);
+
+        uint32_t maxY = height-1;
+        for(;maxY>minY;--maxY){
+            const rgba *row = pixels+maxY*stride;
+            first = simd::firstMatch(row,0,width,range);
+            if(first < width){
+                minX = std::min(minX,first);
+                maxX = std::max(maxX,simd::lastMatch(row,first,width,range));
+                break;
+            }
+        }
+
+        for(uint32_t y=minY+1;y<maxY;++y){
+            const rgba *row = pixels+y*stride;
+            uint32_t left = simd::firstMatch(row,0,minX,range);
+            if(left < minX){
+                minX = left;
+            }
+            uint32_t right = simd::lastMatch(row,maxX+1,width,range);
+            if(right < width){
+                maxX = right;
+            }
+        }
+
+        res.min = {minX,minY};
+        res.max = {maxX,maxY};
+        return true;
+    }
+
+    // Same walk over a classified mask, 64 pixels per step
+    bool find(const ColorMask &mask, box &res){
+        uint32_t begin = mask.x0, end = mask.x0+mask.width;
+        uint32_t minY = mask.y0, endY = mask.y0+mask.height;
+        uint32_t first = end;
+        for(;minY<endY;++minY){
+            first = mask.find(minY,begin,end,true);
+            if(first < end){
+                break;
+            }
+        }
+        if(minY == endY){
+            return false;
+        }
+        uint32_t minX = first;
+        uint32_t maxX = mask.rfind(minY,first,end,true);
+
+        uint32_t maxY = endY-1;
+        for(;maxY>minY;--maxY){
+            first = mask.find(maxY,begin,end,true);
+            if(first < end){
+                minX = std::min(minX,first);
+                maxX = std::max(maxX,mask.rfind(maxY,first,end,true));
+                break;
+            }
+        }
+
+        for(uint32_t y=minY+1;y<maxY;++y){
+            uint32_t left = mask.find(y,begin,minX,true);
+            if(left < minX){
+                minX = left;
+            }
+            uint32_t right = mask.rfind(y,maxX+1,end,true);
+            if(right < end){
+                maxX = right;
+            }
+        }
+
+        res.min = {minX,minY};
+        res.max = {maxX,maxY};
+        return true;
+    }
+}
\ No newline at end of file
@@ -0,0 +1,23 @@
+#pragma once
+
+#include <cmath>
+
+#include "glm.hpp"
+#include "gtc/matrix_transform.hpp"
+
+namespace camera{
+    // View matrix for a camera at -pos, yawed by mouseX and pitched by mouseY
+    glm::mat4 view(glm::vec3 pos, double mouseX, double mouseY){
+        glm::vec2 forwards{-std::sin(mouseX),std::cos(mouseX)};
+        return glm::rotate(glm::mat4(1.0f),(float)mouseX,glm::vec3(0,1,0))*glm::rotate(glm::mat4(1.0f),(float)mouseY,glm::vec3(forwards.y,0,-forwards.x))*glm::translate(glm::mat4(1.0f),pos);
+    }
+    glm::mat4 viewProjection(glm::vec3 pos, double mouseX, double mouseY, float fov, float aspect){
+        glm::mat4 projMat = glm::perspective(fov, aspect, 0.1f, 300.0f);
+        return projMat*view(pos,mouseX,mouseY);
+    }
+    // Position that puts the origin in the middle of the view at the given distance
+    glm::vec3 orbit(float distance, double mouseX, double mouseY){
+        glm::mat3 rotation = glm::mat3(view(glm::vec3(0,0,0),mouseX,mouseY));
+        return glm::transpose(rotation)*glm::vec3(0,0,-distance);
+    }
+}
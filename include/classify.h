@@ -0,0 +1,45 @@
+#pragma once
+
+#include <cstdint>
+
+#include "image.h"
+#include "mask.h"
+#include "simd.h"
+
+namespace classify{
+    // Packs 64 pixels into one word, bit i set if row[i] is inside the range
+    uint64_t word(const rgba *row, const simd::ColorRange &range){
+        uint64_t res = 0;
+        for(int i=0;i<8;++i){
+            res |= (uint64_t)simd::match8(row+8*i,range) << (8*i);
+        }
+        return res;
+    }
+
+    // Classifies width pixels into border and pad mask words
+    void row(const rgba *pixels, uint32_t width, const simd::ColorRange &borderRange, const simd::ColorRange &padRange, uint64_t *b, uint64_t *p){
+        uint32_t x = 0;
+        for(;x+64<=width;x+=64){
+            *b++ = word(pixels+x,borderRange);
+            *p++ = word(pixels+x,padRange);
+        }
+        if(x < width){
+            uint64_t wb = 0, wp = 0;
+            for(uint32_t i=0;x+i<width;++i){
+                wb |= (uint64_t)borderRange.test(pixels[x+i]) << i;
+                wp |= (uint64_t)padRange.test(pixels[x+i]) << i;
+            }
+            *b = wb;
+            *p = wp;
+        }
+    }
+
+    // Classifies the width x height region at (x0,y0) into border and pad masks in one pass
+    void frame(const rgba *pixels, uint32_t stride, uint32_t x0, uint32_t y0, uint32_t width, uint32_t height, const simd::ColorRange &borderRange, const simd::ColorRange &padRange, ColorMask &border, ColorMask &pad){
+        border.resize(x0,y0,width,height);
+        pad.resize(x0,y0,width,height);
+        for(uint32_t y=y0;y<y0+height;++y){
+            row(pixels + y*stride + x0,width,borderRange,padRange,border.row(y),pad.row(y));
+        }
+    }
+}
@@ -0,0 +1,196 @@
+#pragma once
+
+#include <cstdint>
+#include <algorithm>
+
+#include "mask.h"
+#include "bounds.h"
+#include "arena.h"
+
+// Connected pads and clutter in a classified frame. Rows are run-length encoded and runs are joined
+// with union-find, so the cost follows the number of runs rather than pixels.
+namespace components{
+    // Pixels [begin,end) of row y
+    struct run{
+        uint32_t y, begin, end;
+        uint32_t label;
+    };
+    struct component{
+        bounds::box extent;
+        uint64_t area = 0, borderArea = 0;
+        // Raw moments: sums of x, y, x^2, y^2 and xy over the pixels
+        uint64_t sx = 0, sy = 0, sxx = 0, syy = 0, sxy = 0;
+        double cx() const {
+            return (double)this->sx/this->area;
+        }
+        double cy() const {
+            return (double)this->sy/this->area;
+        }
+        // Central second moments divided by area
+        void covariance(double &xx, double &yy, double &xy) const {
+            double x = this->cx(), y = this->cy();
+            xx = (double)this->sxx/this->area - x*x;
+            yy = (double)this->syy/this->area - y*y;
+            xy = (double)this->sxy/this->area - x*y;
+        }
+        void add(const component &c){
+            this->extent.min = {std::min(this->extent.min.x,c.extent.min.x),std::min(this->extent.min.y,c.extent.min.y)};
+            this->extent.max = {std::max(this->extent.max.x,c.extent.max.x),std::max(this->extent.max.y,c.extent.max.y)};
+            this->area += c.area;
+            this->borderArea += c.borderArea;
+            this->sx += c.sx;
+            this->sy += c.sy;
+            this->sxx += c.sxx;
+            this->syy += c.syy;
+            this->sxy += c.sxy;
+        }
+    };
+
+    // Runs in both masks together, counted a word at a time from where set bits start
+    size_t countRuns(const ColorMask &border, const ColorMask &pad){
+        size_t count = 0;
+        for(uint32_t y=border.y0;y<border.y0+border.height;++y){
+            const uint64_t *b = border.row(y), *p = pad.row(y);
+            uint64_t carry = 0;
+            for(uint32_t k=0;k<border.stride;++k){
+                uint64_t w = b[k] | p[k];
+                count += __builtin_popcountll(w & ~((w << 1) | carry));
+                carry = w >> 63;
+            }
+        }
+        return count;
+    }
+
+    class Labeler{
+    public:
+        // Both live in the arena passed to label until it is reset
+        ArenaArray<run> runs;
+        // One per 8-connected group of runs, in order of their first run
+        ArenaArray<component> components;
+        // Labels pixels set in either mask. Both masks must come from the same classification.
+        // Runs are counted first so every table is allocated once at its final size. Statistics
+        // are gathered per run as it is found and merged whenever two labels join, so the pixels
+        // are only visited once.
+        void label(const ColorMask &border, const ColorMask &pad, Arena &arena){
+            size_t capacity = countRuns(border,pad);
+            this->runs = {arena.allocate<run>(capacity),0};
+            this->parent = arena.allocate<uint32_t>(capacity);
+            this->stats = arena.allocate<component>(capacity);
+            size_t prevBegin = 0, prevEnd = 0;
+            for(uint32_t y=border.y0;y<border.y0+border.height;++y){
+                size_t rowBegin = this->runs.size();
+                this->encode(border,pad,y);
+                size_t rowEnd = this->runs.size();
+                // Runs of both rows are sorted, so overlaps are found in one merge-like sweep
+                size_t i = prevBegin, j = rowBegin;
+                while(i < prevEnd && j < rowEnd){
+                    const run &a = this->runs[i], &b = this->runs[j];
+                    // Diagonal neighbours count, hence the inclusive ends
+                    if(a.begin <= b.end && b.begin <= a.end){
+                        this->unite(a.label,b.label);
+                    }
+                    if(a.end < b.end){
+                        ++i;
+                    }else{
+                        ++j;
+                    }
+                }
+                prevBegin = rowBegin;
+                prevEnd = rowEnd;
+            }
+            // Labels are numbered like runs, one each
+            uint32_t labels = this->runs.size(), roots = 0;
+            for(uint32_t l=0;l<labels;++l){
+                roots += this->parent[l] == l;
+            }
+            uint32_t *index = arena.allocate<uint32_t>(labels);
+            this->components = {arena.allocate<component>(roots),0};
+            for(uint32_t l=0;l<labels;++l){
+                if(this->parent[l] == l){
+                    index[l] = this->components.count;
+                    this->components[this->components.count++] = this->stats[l];
+                }
+            }
+            for(run &r : this->runs){
+                r.label = index[this->find(r.label)];
+            }
+        }
+    private:
+        uint32_t *parent = nullptr;
+        component *stats = nullptr;
+
+        // Appends the runs of row y, each with its own new label
+        void encode(const ColorMask &border, const ColorMask &pad, uint32_t y){
+            const uint64_t *b = border.row(y), *p = pad.row(y);
+            uint32_t x = 0;
+            while(x < border.width){
+                // Start of the next run
+                uint64_t w = (b[x>>6] | p[x>>6]) & (~0ULL << (x&63));
+                if(!w){
+                    x = (x & ~63u) + 64;
+                    continue;
+                }
+                uint32_t begin = (x & ~63u) + __builtin_ctzll(w);
+                if(begin >= border.width){
+                    break;
+                }
+                // End of it
+                x = begin;
+                uint32_t end = border.width;
+                uint64_t borderCount = 0;
+                while(x < border.width){
+                    uint32_t k = x>>6;
+                    uint64_t inside = ~(b[k] | p[k]) & (~0ULL << (x&63));
+                    uint32_t stop = inside ? (k << 6) + __builtin_ctzll(inside) : (k << 6) + 64;
+                    stop = std::min(stop,border.width);
+                    uint64_t span = (stop-x == 64 ? ~0ULL : ((1ULL << (stop-x)) - 1) << (x&63));
+                    borderCount += __builtin_popcountll(b[k] & span);
+                    x = stop;
+                    if(inside){
+                        end = stop;
+                        break;
+                    }
+                }
+                this->add(y,begin+border.x0,std::min(end,border.width)+border.x0,borderCount);
+            }
+        }
+        void add(uint32_t y, uint32_t begin, uint32_t end, uint64_t borderCount){
+            uint32_t label = this->runs.count;
+            this->parent[label] = label;
+            this->runs[this->runs.count++] = {y,begin,end,label};
+            component c;
+            uint64_t n = end-begin;
+            c.extent = {{begin,y},{end-1,y}};
+            c.area = n;
+            c.borderArea = borderCount;
+            // Closed form sums over x in [begin,end)
+            auto squares = [](uint64_t k){return k*(k-1)*(2*k-1)/6;};
+            c.sx = (uint64_t)(begin+end-1)*n/2;
+            c.sxx = squares(end) - squares(begin);
+            c.sy = n*y;
+            c.syy = n*y*y;
+            c.sxy = c.sx*y;
+            this->stats[label] = c;
+        }
+        uint32_t find(uint32_t l){
+            while(this->parent[l] != l){
+                this->parent[l] = this->parent[this->parent[l]];
+                l = this->parent[l];
+            }
+            return l;
+        }
+        // The earlier label stays the root, so components keep the order of their first run
+        void unite(uint32_t a, uint32_t b){
+            a = this->find(a);
+            b = this->find(b);
+            if(a == b){
+                return;
+            }
+            if(b < a){
+                std::swap(a,b);
+            }
+            this->parent[b] = a;
+            this->stats[a].add(this->stats[b]);
+        }
+    };
+}
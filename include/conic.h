@@ -0,0 +1,173 @@
+#pragma once
+
+#include <cstddef>
+#include <cmath>
+#include <algorithm>
+
+// Direct least squares ellipse fitting (Fitzgibbon, Pilu and Fisher), in the numerically stable
+// form given by Halir and Flusser
+namespace conic{
+    struct sample{
+        double x, y;
+    };
+    struct ellipse{
+        double cx, cy;
+        // Semi-major and semi-minor axes
+        double a, b;
+        // Direction of the major axis in radians
+        double angle;
+    };
+
+    void invert3(const double m[3][3], double res[3][3]){
+        double det = m[0][0]*(m[1][1]*m[2][2]-m[1][2]*m[2][1]) - m[0][1]*(m[1][0]*m[2][2]-m[1][2]*m[2][0]) + m[0][2]*(m[1][0]*m[2][1]-m[1][1]*m[2][0]);
+        for(int i=0;i<3;++i){
+            for(int j=0;j<3;++j){
+                int r0 = (j+1)%3, r1 = (j+2)%3, c0 = (i+1)%3, c1 = (i+2)%3;
+                res[i][j] = (m[r0][c0]*m[r1][c1] - m[r0][c1]*m[r1][c0])/det;
+            }
+        }
+    }
+
+    // Real roots of x^3 + b x^2 + c x + d
+    int cubicRoots(double b, double c, double d, double roots[3]){
+        double p = c - b*b/3.0, q = 2.0*b*b*b/27.0 - b*c/3.0 + d;
+        double shift = -b/3.0;
+        double disc = q*q/4.0 + p*p*p/27.0;
+        if(disc > 0){
+            double s = std::sqrt(disc);
+            roots[0] = std::cbrt(-q/2.0+s) + std::cbrt(-q/2.0-s) + shift;
+            return 1;
+        }
+        double r = std::sqrt(std::max(-p/3.0,0.0));
+        double phi = r > 0 ? std::acos(std::min(std::max(-q/(2.0*r*r*r),-1.0),1.0)) : 0.0;
+        for(int k=0;k<3;++k){
+            roots[k] = 2.0*r*std::cos((phi - 2.0*M_PI*k)/3.0) + shift;
+        }
+        return 3;
+    }
+
+    // Eigenvector of m for eigenvalue l, from the largest cross product of two rows of m - lI
+    void eigenvector(const double m[3][3], double l, double res[3]){
+        double r[3][3];
+        for(int i=0;i<3;++i){
+            for(int j=0;j<3;++j){
+                r[i][j] = m[i][j] - (i==j ? l : 0.0);
+            }
+        }
+        double best = -1;
+        for(int i=0;i<3;++i){
+            const double *u = r[i], *v = r[(i+1)%3];
+            double c[3] = {u[1]*v[2]-u[2]*v[1],u[2]*v[0]-u[0]*v[2],u[0]*v[1]-u[1]*v[0]};
+            double n = c[0]*c[0]+c[1]*c[1]+c[2]*c[2];
+            if(n > best){
+                best = n;
+                std::copy(c,c+3,res);
+            }
+        }
+    }
+
+    bool fitEllipse(const sample *samples, size_t count, ellipse &res){
+        if(count < 6){
+            return false;
+        }
+        // Centre and scale the samples for conditioning
+        double mx = 0, my = 0;
+        for(size_t i=0;i<count;++i){
+            mx += samples[i].x;
+            my += samples[i].y;
+        }
+        mx /= count;
+        my /= count;
+        double spread = 0;
+        for(size_t i=0;i<count;++i){
+            spread += (samples[i].x-mx)*(samples[i].x-mx) + (samples[i].y-my)*(samples[i].y-my);
+        }
+        double scale = std::sqrt(spread/(2.0*count));
+        if(!(scale > 0)){
+            return false;
+        }
+
+        // Scatter matrices of the quadratic (x^2, xy, y^2) and linear (x, y, 1) parts
+        double s1[3][3] = {}, s2[3][3] = {}, s3[3][3] = {};
+        for(size_t i=0;i<count;++i){
+            double x = (samples[i].x-mx)/scale, y = (samples[i].y-my)/scale;
+            double d1[3] = {x*x,x*y,y*y}, d2[3] = {x,y,1.0};
+            for(int j=0;j<3;++j){
+                for(int k=0;k<3;++k){
+                    s1[j][k] += d1[j]*d1[k];
+                    s2[j][k] += d1[j]*d2[k];
+                    s3[j][k] += d2[j]*d2[k];
+                }
+            }
+        }
+        double s3Inv[3][3], t[3][3], m[3][3];
+        invert3(s3,s3Inv);
+        for(int j=0;j<3;++j){
+            for(int k=0;k<3;++k){
+                t[j][k] = 0;
+                for(int l=0;l<3;++l){
+                    t[j][k] -= s3Inv[j][l]*s2[k][l];
+                }
+            }
+        }
+        for(int j=0;j<3;++j){
+            for(int k=0;k<3;++k){
+                m[j][k] = s1[j][k];
+                for(int l=0;l<3;++l){
+                    m[j][k] += s2[j][l]*t[l][k];
+                }
+            }
+        }
+        // Premultiply by the inverse of the constraint matrix
+        double mc[3][3];
+        for(int k=0;k<3;++k){
+            mc[0][k] = m[2][k]/2.0;
+            mc[1][k] = -m[1][k];
+            mc[2][k] = m[0][k]/2.0;
+        }
+
+        double tr = mc[0][0]+mc[1][1]+mc[2][2];
+        double minors = mc[0][0]*mc[1][1]-mc[0][1]*mc[1][0] + mc[0][0]*mc[2][2]-mc[0][2]*mc[2][0] + mc[1][1]*mc[2][2]-mc[1][2]*mc[2][1];
+        double det = mc[0][0]*(mc[1][1]*mc[2][2]-mc[1][2]*mc[2][1]) - mc[0][1]*(mc[1][0]*mc[2][2]-mc[1][2]*mc[2][0]) + mc[0][2]*(mc[1][0]*mc[2][1]-mc[1][1]*mc[2][0]);
+        double roots[3];
+        int rootCount = cubicRoots(-tr,minors,-det,roots);
+
+        // The ellipse is the eigenvector with 4AC - B^2 > 0
+        double a1[3];
+        bool found = false;
+        double bestCond = 0;
+        for(int i=0;i<rootCount;++i){
+            double v[3];
+            eigenvector(mc,roots[i],v);
+            double cond = 4.0*v[0]*v[2] - v[1]*v[1];
+            if(cond > bestCond){
+                bestCond = cond;
+                std::copy(v,v+3,a1);
+                found = true;
+            }
+        }
+        if(!found){
+            return false;
+        }
+        double a2[3];
+        for(int j=0;j<3;++j){
+            a2[j] = t[j][0]*a1[0] + t[j][1]*a1[1] + t[j][2]*a1[2];
+        }
+
+        double A = a1[0], B = a1[1], C = a1[2], D = a2[0], E = a2[1], F = a2[2];
+        double den = 4.0*A*C - B*B;
+        double cx = (B*E - 2.0*C*D)/den, cy = (B*D - 2.0*A*E)/den;
+        double f0 = F + (D*cx + E*cy)/2.0;
+        double root = std::sqrt((A-C)*(A-C)/4.0 + B*B/4.0);
+        double lMin = (A+C)/2.0 - root, lMax = (A+C)/2.0 + root;
+        if(!(-f0/lMin > 0) || !(-f0/lMax > 0)){
+            return false;
+        }
+        res.cx = cx*scale + mx;
+        res.cy = cy*scale + my;
+        res.a = std::sqrt(-f0/lMin)*scale;
+        res.b = std::sqrt(-f0/lMax)*scale;
+        res.angle = 0.5*std::atan2(B,A-C) + 0.5*M_PI;
+        return true;
+    }
+}
@@ -9,13 +9,14 @@ namespace controls{
     double mouseX = 0, mouseY = 0;
     double sensitivity = 0.001;
     double speed = 0.01;
-    constexpr uint8_t RIGHT =       0b0000001;
-    constexpr uint8_t LEFT =        0b0000010;
-    constexpr uint8_t FORWARDS =    0b0000100;
-    constexpr uint8_t BACKWARDS =   0b0001000;
-    constexpr uint8_t UP =          0b0010000;
-    constexpr uint8_t DOWN =        0b0100000;
-    constexpr uint8_t SS =          0b1000000;
+    constexpr uint8_t RIGHT =       0b00000001;
+    constexpr uint8_t LEFT =        0b00000010;
+    constexpr uint8_t FORWARDS =    0b00000100;
+    constexpr uint8_t BACKWARDS =   0b00001000;
+    constexpr uint8_t UP =          0b00010000;
+    constexpr uint8_t DOWN =        0b00100000;
+    constexpr uint8_t SS =          0b01000000;
+    constexpr uint8_t PROFILE =     0b10000000;
 
     void key_callback(GLFWwindow *window, int key, int scancode, int action, int mods){
         if(action == GLFW_PRESS){
@@ -27,6 +28,7 @@ namespace controls{
                 case GLFW_KEY_SPACE:controls |= DOWN;   break;
                 case GLFW_KEY_LEFT_SHIFT:controls |= UP;break;
                 case GLFW_KEY_1:controls |= SS;         break;
+                case GLFW_KEY_P:controls |= PROFILE;    break;
             }
         }else if(action == GLFW_RELEASE){
             switch(key){
@@ -37,6 +39,7 @@ namespace controls{
                 case GLFW_KEY_SPACE:controls &= ~DOWN;   break;
                 case GLFW_KEY_LEFT_SHIFT:controls &= ~UP;break;
                 case GLFW_KEY_1:controls &= ~SS;         break;
+                case GLFW_KEY_P:controls &= ~PROFILE;    break;
 
             }
         }
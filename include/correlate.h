@@ -0,0 +1,212 @@
+#pragma once
+
+#include <cstdint>
+#include <cmath>
+#include <algorithm>
+#include <vector>
+
+#include "mask.h"
+#include "components.h"
+#include "fft.h"
+
+// Pad size from correlating its mask with the ellipse the pad's circle (filter::circle) projects to.
+// Border and pad pixels together are sampled into a GRID x GRID image along the component's
+// principal axes, scaled so the semi-major axis its moments suggest is RADIUS cells long. The
+// templates then only vary in scale and aspect around that guess, so their spectra are computed
+// once. Every frame costs one forward and a fixed number of inverse FFTs, however large the pad
+// is, and holes from noise or a covered part of the pad only lower the match instead of stopping a
+// walk along the edge.
+namespace correlate{
+    constexpr uint32_t GRID = 32;
+    constexpr float RADIUS = 8.0f;
+    // Template semi-major axes RADIUS*(1+SCALE_STEP*(k-SCALES/2))
+    constexpr int SCALES = 13;
+    constexpr float SCALE_STEP = 0.05f;
+    // Template minor to major ratios (i+1)/ASPECTS
+    constexpr int ASPECTS = 16;
+    // Aspects tried either side of the one the moments suggest
+    constexpr int ASPECT_SPAN = 2;
+    // Scores below this are not taken for a pad, half of one already scores about 0.6
+    constexpr double MIN_SCORE = 0.75;
+
+    struct estimate{
+        // Centre and semi-axes in frame pixels, angle of the major axis in radians
+        double cx, cy;
+        double a, b;
+        double angle;
+        // Overlap of mask and best template, 2|M&T|/(|M|+|T|)
+        double score;
+    };
+
+    class Correlator{
+    public:
+        Correlator() : plan(GRID), spectra((size_t)SCALES*ASPECTS*GRID*GRID), areas(SCALES*ASPECTS), image(GRID*GRID), product(GRID*GRID){
+            for(int s=0;s<SCALES;++s){
+                for(int q=0;q<ASPECTS;++q){
+                    fft::complex *t = &this->spectra[(size_t)(s*ASPECTS+q)*GRID*GRID];
+                    this->areas[s*ASPECTS+q] = ellipse(t,radius(s),radius(s)*(q+1)/ASPECTS);
+                    this->plan.transform2d(t,false);
+                    for(uint32_t i=0;i<GRID*GRID;++i){
+                        t[i] = std::conj(t[i]);
+                    }
+                }
+            }
+        }
+        // Scale and aspect of component c of the labelled masks. False if it is too small to have
+        // a shape.
+        bool run(const ColorMask &border, const ColorMask &pad, const components::component &c, estimate &res){
+            double xx, yy, xy;
+            c.covariance(xx,yy,xy);
+            double mean = 0.5*(xx+yy), spread = std::sqrt(0.25*(xx-yy)*(xx-yy) + xy*xy);
+            // A filled ellipse has variance a^2/4 along its major axis
+            double a0 = 2.0*std::sqrt(mean+spread), b0 = 2.0*std::sqrt(std::max(mean-spread,0.0));
+            if(a0 < 2.0){
+                return false;
+            }
+            double angle = 0.5*std::atan2(2.0*xy,xx-yy);
+            double cosA = std::cos(angle), sinA = std::sin(angle);
+            // Frame pixels per cell
+            double cell = a0/RADIUS;
+            // Pixel centres are at index + 0.5
+            double cx = c.cx()+0.5, cy = c.cy()+0.5;
+
+            // 2x2 samples per cell, like the templates' coverage
+            float maskArea = 0.0f;
+            for(uint32_t v=0;v<GRID;++v){
+                for(uint32_t u=0;u<GRID;++u){
+                    float inside = 0.0f;
+                    for(int sy=0;sy<2;++sy){
+                        double gy = (v+0.25+0.5*sy-GRID/2.0)*cell;
+                        for(int sx=0;sx<2;++sx){
+                            double gx = (u+0.25+0.5*sx-GRID/2.0)*cell;
+                            double x = cx + gx*cosA - gy*sinA, y = cy + gx*sinA + gy*cosA;
+                            if(x >= 0.0 && y >= 0.0){
+                                uint32_t px = x, py = y;
+                                inside += border.test(px,py) || pad.test(px,py);
+                            }
+                        }
+                    }
+                    this->image[v*GRID+u] = 0.25f*inside;
+                    maskArea += 0.25f*inside;
+                }
+            }
+            if(maskArea == 0.0f){
+                return false;
+            }
+            this->plan.transform2d(this->image.data(),false);
+
+            // Aspect at the middle scale, then every scale at the best aspect
+            int q0 = std::clamp((int)std::lround(b0/a0*ASPECTS)-1,0,ASPECTS-1);
+            int qBegin = std::max(q0-ASPECT_SPAN,0), qEnd = std::min(q0+ASPECT_SPAN+1,ASPECTS);
+            for(int q=qBegin;q<qEnd;++q){
+                this->candidates[q-qBegin] = {SCALES/2,q};
+            }
+            this->correlate(this->candidates,qEnd-qBegin,maskArea);
+            int best = 0;
+            for(int i=1;i<qEnd-qBegin;++i){
+                if(this->scores[i] > this->scores[best]){
+                    best = i;
+                }
+            }
+            int q = this->candidates[best].aspect;
+            for(int s=0;s<SCALES;++s){
+                this->candidates[s] = {s,q};
+            }
+            this->correlate(this->candidates,SCALES,maskArea);
+            int k = 0;
+            for(int s=1;s<SCALES;++s){
+                if(this->scores[s] > this->scores[k]){
+                    k = s;
+                }
+            }
+            // Vertex of the parabola through the best score and its neighbours
+            double offset = 0.0;
+            if(k > 0 && k < SCALES-1){
+                double l = this->scores[k-1], m = this->scores[k], r = this->scores[k+1];
+                double d = l - 2.0*m + r;
+                if(d < 0.0){
+                    offset = std::clamp(0.5*(l-r)/d,-0.5,0.5);
+                }
+            }
+            double a = RADIUS*(1.0 + SCALE_STEP*(k+offset-SCALES/2))*cell;
+            res.cx = cx;
+            res.cy = cy;
+            res.a = a;
+            res.b = a*(q+1)/ASPECTS;
+            res.angle = angle;
+            res.score = this->scores[k];
+            return true;
+        }
+    private:
+        struct candidate{
+            int scale, aspect;
+        };
+        fft::Plan plan;
+        // Conjugated spectra of every template, scale major
+        std::vector<fft::complex> spectra;
+        std::vector<float> areas;
+        std::vector<fft::complex> image, product;
+        candidate candidates[std::max(SCALES,2*ASPECT_SPAN+1)];
+        double scores[std::max(SCALES,2*ASPECT_SPAN+1)];
+
+        static float radius(int scale){
+            return RADIUS*(1.0f + SCALE_STEP*(scale-SCALES/2));
+        }
+        // Filled ellipse centred on the top left corner of cell (0,0), wrapping around the edges,
+        // with 4x4 samples per cell so the area changes smoothly with the axes. The sampled mask
+        // has the centroid on a cell corner too, so the peak falls on a whole shift. Returns the
+        // area in cells.
+        static float ellipse(fft::complex *t, float a, float b){
+            float area = 0.0f;
+            for(uint32_t v=0;v<GRID;++v){
+                for(uint32_t u=0;u<GRID;++u){
+                    float cover = 0.0f;
+                    for(int sy=0;sy<4;++sy){
+                        for(int sx=0;sx<4;++sx){
+                            float x = (int)(u < GRID/2 ? u : u-GRID) + (sx+0.5f)/4.0f;
+                            float y = (int)(v < GRID/2 ? v : v-GRID) + (sy+0.5f)/4.0f;
+                            cover += (x*x)/(a*a) + (y*y)/(b*b) <= 1.0f;
+                        }
+                    }
+                    t[v*GRID+u] = cover/16.0f;
+                    area += cover/16.0f;
+                }
+            }
+            return area;
+        }
+        // scores[i] for each candidate. Correlations are real, so two share one inverse transform,
+        // the first in the real part and the second in the imaginary part.
+        void correlate(const candidate *list, int count, float maskArea){
+            for(int i=0;i<count;i+=2){
+                const fft::complex *t1 = this->spectrum(list[i]);
+                const fft::complex *t2 = i+1 < count ? this->spectrum(list[i+1]) : nullptr;
+                for(uint32_t j=0;j<GRID*GRID;++j){
+                    fft::complex m = this->image[j];
+                    fft::complex p = fft::mul(m,t1[j]);
+                    if(t2){
+                        fft::complex p2 = fft::mul(m,t2[j]);
+                        p += fft::complex(-p2.imag(),p2.real());
+                    }
+                    this->product[j] = p;
+                }
+                this->plan.transform2d(this->product.data(),true);
+                float peak1 = 0.0f, peak2 = 0.0f;
+                for(uint32_t j=0;j<GRID*GRID;++j){
+                    peak1 = std::max(peak1,this->product[j].real());
+                    peak2 = std::max(peak2,this->product[j].imag());
+                }
+                float scale = 1.0f/(GRID*GRID);
+                this->scores[i] = 2.0*peak1*scale/(maskArea+this->area(list[i]));
+                if(t2){
+                    this->scores[i+1] = 2.0*peak2*scale/(maskArea+this->area(list[i+1]));
+                }
+            }
+        }
+        const fft::complex *spectrum(const candidate &c) const {
+            return &this->spectra[(size_t)(c.scale*ASPECTS+c.aspect)*GRID*GRID];
+        }
+        float area(const candidate &c) const {
+            return this->areas[c.scale*ASPECTS+c.aspect];
+        }
+    };
+}
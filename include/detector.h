@@ -0,0 +1,616 @@
+#pragma once
+
+#include <cstdint>
+#include <cmath>
+#include <iostream>
+#include <memory>
+#include <vector>
+
+#include "image.h"
+#include "mask.h"
+#include "bounds.h"
+#include "classify.h"
+#include "tracker.h"
+#include "conic.h"
+#include "analysis.h"
+#include "thread_pool.h"
+#include "pyramid.h"
+#include "components.h"
+#include "correlate.h"
+#include "moments.h"
+#include "edges.h"
+#include "yuv.h"
+#include "arena.h"
+#include "snapshot.h"
+#include "profiler.h"
+
+namespace detector{
+    // Values of Detection::accuracy
+    constexpr int NONE = 0;
+    constexpr int BOUNDS = 1;
+    // Major axis from the moments of the pad's masks, when the border could not be measured
+    constexpr int MOMENTS = 2;
+    constexpr int BORDER = 3;
+
+    // How the major diameter is measured
+    enum Engine{
+        // Hill climbing along the border with Image::traceBorder
+        TRACE,
+        // Least squares ellipse through the outer edge of the border
+        FIT,
+        // Ellipse templates correlated with the pad's mask, see correlate.h
+        CORRELATE
+    };
+
+    struct Config{
+        rgba padColor;
+        rgba borderColor;
+        int tolerance;
+        float fov;
+        Engine engine = TRACE;
+        // Halvings of the frame searched before full resolution when nothing is tracked, 0 to search
+        // the full frame straight away
+        uint32_t pyramidLevels = 2;
+        // FIT through subpixel luminance edges around the pad instead of the row ends of the border
+        // mask
+        bool subpixelEdges = false;
+    };
+#ifdef LANDINGPAD_DEBUG
+    // Debug builds draw every pixel the search passes over into the saved snapshot
+    typedef annotate::Color Annotation;
+    Annotation annotation(rgba color){
+        return {color};
+    }
+#else
+    // Otherwise the annotation calls compile away
+    typedef annotate::None Annotation;
+    Annotation annotation(rgba){
+        return {};
+    }
+#endif
+
+    // Smallest pad, in pixels of a pyramid level, the border is traced on
+    constexpr uint32_t MIN_COARSE_DIAMETER = 64;
+    // Luminance step, in 0..255, of an edge FIT uses with Config::subpixelEdges. The border against
+    // the background steps by about 75.
+    constexpr uint32_t EDGE_THRESHOLD = 20;
+    // Furthest, in pixels, an edge may be from the ellipse through the border's row ends
+    constexpr double EDGE_DISTANCE = 2.0;
+    struct Detection{
+        double calculatedDistance = 0.0;
+        int accuracy = NONE;
+        // Pad extents in the frame, only set by detectAll
+        bounds::box extent = {{0,0},{0,0}};
+    };
+
+    // Everything done with a frame after it has been read back
+    class Detector{
+    public:
+        Config config;
+        // Last full frame or window analysis
+        analysis::result analysed;
+        // Where detect(...,save) sends the pad section, landing_pad.png is overwritten without one
+        snapshot::Encoder *snapshots = nullptr;
+        // Scratch memory for a frame comes from arena, which the caller resets between frames.
+        // Without one the detector uses its own and resets it on every call.
+        Detector(const Config &config, ThreadPool *pool = nullptr, Arena *arena = nullptr)
+            : config(config), arena(arena ? arena : &this->ownArena),
+            borderRange(config.borderColor,config.tolerance,config.tolerance,config.tolerance),
+            padRange(config.padColor,config.tolerance,config.tolerance,config.tolerance),
+            borderYuvRange(config.borderColor,config.tolerance,config.tolerance,config.tolerance),
+            padYuvRange(config.padColor,config.tolerance,config.tolerance,config.tolerance),
+            analyzer(pool), accumulator(pool), edgeFinder(pool){}
+        Tracker tracker;
+        // A camera frame measured where it is, always with FIT. The other engines and snapshots
+        // read RGBA.
+        Detection detect(const yuv::Frame &frame){
+            PROFILE_SCOPE(DETECT);
+            this->begin(frame.width,frame.height);
+            Detection res;
+            if(!this->fit(frame,res) && this->tracker.tracking){
+                this->tracker.lose();
+                this->fit(frame,res);
+            }
+            return res;
+        }
+        Detection detect(const rgba *pixels, uint32_t width, uint32_t height, uint32_t stride, bool save = false){
+            PROFILE_SCOPE(DETECT);
+            this->begin(width,height);
+            Detection res;
+            if(this->config.engine == FIT){
+                if(!this->fit(pixels,width,height,stride,res) && this->tracker.tracking){
+                    this->tracker.lose();
+                    this->fit(pixels,width,height,stride,res);
+                }
+                return res;
+            }
+            if(this->config.engine == CORRELATE){
+                if(!this->correlate(pixels,width,height,stride,res) && this->tracker.tracking){
+                    this->tracker.lose();
+                    this->correlate(pixels,width,height,stride,res);
+                }
+                return res;
+            }
+            if(this->tracker.tracking && this->track(pixels,width,height,stride,res,save)){
+                return res;
+            }
+            this->tracker.lose();
+
+            bounds::box window = {{0,0},{width-1,height-1}};
+            if(this->config.pyramidLevels > 0 && this->coarse(pixels,width,height,stride,res,save,window)){
+                return res;
+            }
+            this->analyzer.run(pixels,stride,window,this->borderRange,this->padRange,&this->borderMask,&this->padMask,this->analysed);
+
+            bounds::box extent = {{0,0},{0,0}};
+            if(this->analysed.found){
+                const components::component *pad = this->largestPad(this->borderMask,this->padMask);
+                extent = pad ? pad->extent : this->analysed.extent;
+            }
+            uint32_t dx = extent.max.x - extent.min.x;
+            uint32_t dy = extent.max.y - extent.min.y;
+            if(dx > 0 && dy > 0){
+                res.accuracy = BOUNDS;
+                point major1, major2;
+                bool rMajor;
+                if(this->trace(pixels,stride,extent,this->borderMask,this->padMask,major1,major2,rMajor,save)){
+                    res.calculatedDistance = this->distance(std::sqrt((major2-major1).magSq()),width);
+                    res.accuracy = BORDER;
+                    this->tracker.update(extent,major1,major2,rMajor);
+                }
+            }
+            if(res.accuracy == BOUNDS){
+                this->measureMoments(extent,width,res);
+            }
+            return res;
+        }
+        // Every pad in the frame, each measured on its own. Tracking is left alone.
+        std::vector<Detection> detectAll(const rgba *pixels, uint32_t width, uint32_t height, uint32_t stride){
+            PROFILE_SCOPE(DETECT);
+            this->begin(width,height);
+            std::vector<Detection> found;
+            this->analyzer.run(pixels,stride,{{0,0},{width-1,height-1}},this->borderRange,this->padRange,&this->borderMask,&this->padMask,this->analysed);
+            if(!this->analysed.found){
+                return found;
+            }
+            this->labeler.label(this->borderMask,this->padMask,*this->arena);
+            for(const components::component &c : this->labeler.components){
+                uint32_t dx = c.extent.max.x - c.extent.min.x;
+                uint32_t dy = c.extent.max.y - c.extent.min.y;
+                if(!isPad(c) || dx == 0 || dy == 0){
+                    continue;
+                }
+                Detection res;
+                res.extent = c.extent;
+                point major1, major2;
+                bool rMajor;
+                if(this->trace(pixels,stride,c.extent,this->borderMask,this->padMask,major1,major2,rMajor,false)){
+                    res.calculatedDistance = this->distance(std::sqrt((major2-major1).magSq()),width);
+                    res.accuracy = BORDER;
+                }else{
+                    this->measureMoments(c.extent,width,res);
+                }
+                found.push_back(res);
+            }
+            return found;
+        }
+        // Distance to a pad of diameter 2 that spans the given number of pixels
+        double distance(double diameter, uint32_t width){
+            return ((double)width/diameter) / std::tan(0.5*this->config.fov);
+        }
+    private:
+        Arena ownArena;
+        Arena *arena;
+        uint32_t frameWidth = 0, frameHeight = 0;
+
+        // Sizes every buffer kept between frames for the largest window a frame of this size can
+        // need, so they never grow once the first frame is through
+        void begin(uint32_t width, uint32_t height){
+            if(this->arena == &this->ownArena){
+                this->ownArena.reset();
+            }
+            if(width == this->frameWidth && height == this->frameHeight){
+                return;
+            }
+            this->frameWidth = width;
+            this->frameHeight = height;
+            this->borderMask.reserve(width,height);
+            this->padMask.reserve(width,height);
+            this->coarseBorder.reserve(width/2,height/2);
+            this->coarsePad.reserve(width/2,height/2);
+            this->analysed.samples.reserve(2*height);
+            this->coarseResult.samples.reserve(height);
+            if(this->config.subpixelEdges){
+                this->edgeFinder.maxima.reserve(width,height);
+            }
+            // The pyramid levels are the bulk of the arena's work, runs and annotations come on top
+            size_t levels = 0;
+            for(uint32_t l=1;l<=this->config.pyramidLevels;++l){
+                levels += (size_t)(width >> l)*(height >> l)*sizeof(rgba);
+            }
+            this->arena->reserve(levels + (size_t)(width+height)*64);
+        }
+        // Major endpoints in frame coordinates from the border and pad masks of the pad extents
+        bool trace(const rgba *pixels, uint32_t stride, const bounds::box &extent, const ColorMask &borderMask, const ColorMask &padMask, point &major1, point &major2, bool &rMajor, bool save){
+            uint32_t minX = extent.min.x, minY = extent.min.y, maxX = extent.max.x, maxY = extent.max.y;
+            uint32_t dx = maxX - minX;
+            uint32_t dy = maxY - minY;
+            ImageView padSection = ImageView(pixels,{minX,minY},{maxX,maxY},stride,this->arena);
+
+            //Find top of landing pad
+            point centerTop;
+            if(!padSection.linearSearch({dx/2,0},{0,1},centerTop,padMask,annotation({255,0,0,255}))){return false;}
+
+            //Find direction of major
+            if(!padSection.xDirOfMax(centerTop,rMajor,padMask,borderMask,annotation({255,255,0,255}))){return false;}
+
+            //Approximate first major radius
+            point center = {dx/2,dy/2};
+            float radiusSquared;
+            int checkCount = (padSection.width+padSection.height)/20;
+            if(!padSection.traceBorder(centerTop,center,rMajor,false,checkCount,major1,radiusSquared,borderMask,annotation({255,0,255,255}))){return false;}
+
+            //Approximate second major radius
+            point major2Guess = {dx-major1.x,dy-major1.y};
+
+            //Move second major radius guess onto pad
+            direction c_m1 = major1-center;
+            point major2Guess2;
+            if(!padSection.linearSearch(major2Guess,{c_m1.dx>0?1:-1,c_m1.dy>0?1:-1},major2Guess2,padMask,annotation({255,0,0,255}))){return false;}
+
+            //Find better approximation of second major radius
+            float r2Squared;
+            if(!padSection.traceBorder(major2Guess2,major1,!rMajor,false,checkCount,major2,r2Squared,borderMask,annotation({255,0,255,255}))){return false;}
+
+            //Find better approximation of first major radius
+            if(!padSection.traceBorder(major1,major2,rMajor,false,checkCount,major1,radiusSquared,borderMask,annotation({255,0,255,255}))){return false;}
+
+            if(save){
+                this->snapshot(padSection);
+            }
+            major1 = frame(padSection,major1);
+            major2 = frame(padSection,major2);
+            return true;
+        }
+        // MOMENTS from the masks inside extent, BOUNDS from its larger side if they make no ellipse
+        void measureMoments(const bounds::box &extent, uint32_t width, Detection &res){
+            moments::sums sums;
+            moments::ellipse shape;
+            this->accumulator.run(this->borderMask,this->padMask,extent,sums);
+            if(moments::fit(sums,shape)){
+                res.calculatedDistance = this->distance(2.0*shape.a,width);
+                res.accuracy = MOMENTS;
+            }else{
+                res.calculatedDistance = this->distance(std::max(extent.max.x-extent.min.x,extent.max.y-extent.min.y),width);
+                res.accuracy = BOUNDS;
+            }
+        }
+        // A pad has both colours, anything made of one of them is clutter
+        static bool isPad(const components::component &c){
+            return c.borderArea > 0 && c.borderArea < c.area;
+        }
+        // The largest pad among the labelled masks, so other dark objects in view do not stretch its
+        // extent. Null if there is none.
+        const components::component *largestPad(const ColorMask &borderMask, const ColorMask &padMask){
+            this->labeler.label(borderMask,padMask,*this->arena);
+            const components::component *best = nullptr;
+            for(const components::component &c : this->labeler.components){
+                if(isPad(c) && (!best || c.area > best->area)){
+                    best = &c;
+                }
+            }
+            return best;
+        }
+        // Traces the pad on the coarsest pyramid level where it is at least MIN_COARSE_DIAMETER wide,
+        // then refines the majors at full resolution the same way a tracked frame is. Otherwise window
+        // is narrowed to where the coarsest level saw the pad, for the full resolution search.
+        bool coarse(const rgba *pixels, uint32_t width, uint32_t height, uint32_t stride, Detection &res, bool save, bounds::box &window){
+            PROFILE_SCOPE(PYRAMID);
+            uint32_t levels = this->config.pyramidLevels;
+            this->pyr.build(pixels,width,height,stride,levels,*this->arena,this->analyzer.pool);
+            this->pyr.prepare(levels);
+            bounds::box located;
+            if(!pyramid::find(this->pyr,levels,this->borderRange,this->padRange,located)){
+                return false;
+            }
+            window = pyramid::frame(this->pyr,levels,located,2u << levels);
+            uint32_t diameter = std::max(located.max.x-located.min.x,located.max.y-located.min.y)+1;
+            for(int l=levels;l>=1;--l){
+                if((diameter << (levels-l)) < MIN_COARSE_DIAMETER){
+                    continue;
+                }
+                this->pyr.prepare(l);
+                bounds::box coarseWindow = {
+                    {window.min.x >> l,window.min.y >> l},
+                    {std::min(window.max.x >> l,this->pyr.width(l)-1),std::min(window.max.y >> l,this->pyr.height(l)-1)}
+                };
+                this->analyzer.run(this->pyr.level(l),this->pyr.stride(l),coarseWindow,this->borderRange,this->padRange,&this->coarseBorder,&this->coarsePad,this->coarseResult);
+                bounds::box extent = this->coarseResult.extent;
+                if(this->coarseResult.found){
+                    if(const components::component *pad = this->largestPad(this->coarseBorder,this->coarsePad)){
+                        extent = pad->extent;
+                    }
+                }
+                if(!this->coarseResult.found || extent.max.x == extent.min.x || extent.max.y == extent.min.y){
+                    continue;
+                }
+                point major1, major2;
+                bool rMajor;
+                if(!this->trace(this->pyr.level(l),this->pyr.stride(l),extent,this->coarseBorder,this->coarsePad,major1,major2,rMajor,false)){
+                    continue;
+                }
+                uint32_t half = (1u << l)/2;
+                this->tracker.lose();
+                this->tracker.update(pyramid::frame(this->pyr,l,extent,0),{(major1.x << l)+half,(major1.y << l)+half},{(major2.x << l)+half,(major2.y << l)+half},rMajor);
+                if(this->track(pixels,width,height,stride,res,save)){
+                    return true;
+                }
+                this->tracker.lose();
+            }
+            return false;
+        }
+        // Traces the border from last frame's major endpoints inside the predicted window only.
+        // False if the pad is not where it was expected, the caller then searches the whole frame.
+        bool track(const rgba *pixels, uint32_t width, uint32_t height, uint32_t stride, Detection &res, bool save){
+            PROFILE_SCOPE(TRACK);
+            bounds::box window = this->tracker.window(width,height);
+            uint32_t ww = window.max.x-window.min.x+1, wh = window.max.y-window.min.y+1;
+            bounds::box extent;
+            if(!bounds::find(pixels+window.min.y*stride+window.min.x,ww,wh,stride,this->borderRange,extent)){
+                return false;
+            }
+            // Extents touching the window edge may continue past it
+            if((extent.min.x == 0 && window.min.x > 0) || (extent.min.y == 0 && window.min.y > 0)
+                || (extent.max.x == ww-1 && window.max.x < width-1) || (extent.max.y == wh-1 && window.max.y < height-1)){
+                return false;
+            }
+            extent.min = {extent.min.x+window.min.x,extent.min.y+window.min.y};
+            extent.max = {extent.max.x+window.min.x,extent.max.y+window.min.y};
+            uint32_t dx = extent.max.x - extent.min.x;
+            uint32_t dy = extent.max.y - extent.min.y;
+            if(dx == 0 || dy == 0){
+                return false;
+            }
+
+            ImageView padSection = ImageView(pixels,window.min,{window.max.x+1,window.max.y+1},stride,this->arena);
+            point major1 = local(padSection,this->tracker.predict(this->tracker.major1));
+            point major2 = local(padSection,this->tracker.predict(this->tracker.major2));
+            bool rMajor = this->tracker.rMajor;
+            int checkCount = (dx+dy)/20;
+            float radiusSquared, r2Squared;
+            match::Range border = {this->borderRange};
+            if(!padSection.traceBorder(major2,major1,!rMajor,false,checkCount,major2,r2Squared,border,annotation({255,0,255,255}))){return false;}
+            if(!padSection.traceBorder(major1,major2,rMajor,false,checkCount,major1,radiusSquared,border,annotation({255,0,255,255}))){return false;}
+
+            // Reject jumps the motion cannot explain
+            double diameter = std::sqrt((major2-major1).magSq());
+            double lastDiameter = std::sqrt((this->tracker.major2-this->tracker.major1).magSq());
+            if(diameter < 0.5*lastDiameter || diameter > 2.0*lastDiameter){
+                return false;
+            }
+
+            res.calculatedDistance = this->distance(diameter,width);
+            res.accuracy = BORDER;
+            this->tracker.update(extent,frame(padSection,major1),frame(padSection,major2),rMajor);
+
+            if(save){
+                this->snapshot(padSection);
+            }
+            return true;
+        }
+        // Fits an ellipse to the left and right ends of the border in every row of the search window,
+        // or to its outer edge with Config::subpixelEdges. False if the pad may continue past a
+        // tracked window.
+        bool fit(const rgba *pixels, uint32_t width, uint32_t height, uint32_t stride, Detection &res){
+            bounds::box window = {{0,0},{width-1,height-1}};
+            if(this->tracker.tracking){
+                window = this->tracker.window(width,height);
+            }
+            res = Detection();
+            uint32_t levels = this->config.pyramidLevels;
+            bounds::box located;
+            if(this->tracker.tracking || levels == 0){
+                this->analyzer.run(pixels,stride,window,this->borderRange,this->padRange,nullptr,nullptr,this->analysed);
+            }else{
+                PROFILE_SCOPE(PYRAMID);
+                this->pyr.build(pixels,width,height,stride,levels,*this->arena,this->analyzer.pool);
+                this->pyr.prepare(levels);
+                if(pyramid::find(this->pyr,levels,this->borderRange,this->padRange,located)){
+                    window = pyramid::frame(this->pyr,levels,located,2u << levels);
+                    pyramid::refine(this->pyr,levels,window,this->borderRange,this->padRange,*this->arena,this->analysed);
+                }else{
+                    this->analyzer.run(pixels,stride,window,this->borderRange,this->padRange,nullptr,nullptr,this->analysed);
+                }
+            }
+            return this->fitAnalysed(pixels,width,height,stride,window,res);
+        }
+        // FIT on the Y and UV planes, with the full frame searched when nothing is tracked
+        bool fit(const yuv::Frame &frame, Detection &res){
+            bounds::box window = {{0,0},{frame.width-1,frame.height-1}};
+            if(this->tracker.tracking){
+                window = this->tracker.window(frame.width,frame.height);
+                window.min.x &= ~1u;
+            }
+            res = Detection();
+            this->analyzer.run(frame,window,this->borderYuvRange,this->padYuvRange,nullptr,nullptr,this->analysed);
+            return this->fitAnalysed(nullptr,frame.width,frame.height,0,window,res);
+        }
+        // The ellipse through the border ends analysed in window. Subpixel edges need pixels.
+        bool fitAnalysed(const rgba *pixels, uint32_t width, uint32_t height, uint32_t stride, const bounds::box &window, Detection &res){
+            if(!this->analysed.found){
+                return !this->tracker.tracking;
+            }
+            const bounds::box &extent = this->analysed.extent;
+            if(this->tracker.tracking && ((extent.min.x == window.min.x && window.min.x > 0) || (extent.min.y == window.min.y && window.min.y > 0)
+                || (extent.max.x == window.max.x && window.max.x < width-1) || (extent.max.y == window.max.y && window.max.y < height-1))){
+                return false;
+            }
+            uint32_t dx = extent.max.x - extent.min.x;
+            uint32_t dy = extent.max.y - extent.min.y;
+            if(dx == 0 || dy == 0){
+                return !this->tracker.tracking;
+            }
+            res.accuracy = BOUNDS;
+            res.calculatedDistance = this->distance(std::max(dx,dy),width);
+
+            conic::ellipse shape;
+            bool fitted;
+            {
+                PROFILE_SCOPE(FIT);
+                fitted = conic::fitEllipse(this->analysed.samples.data(),this->analysed.samples.size(),shape);
+            }
+            const conic::sample *outer;
+            size_t count;
+            if(fitted && this->config.subpixelEdges && pixels && this->edgeSamples(pixels,width,height,stride,extent,shape,outer,count)){
+                PROFILE_SCOPE(FIT);
+                conic::ellipse refined;
+                if(conic::fitEllipse(outer,count,refined)){
+                    shape = refined;
+                }
+            }
+            if(!fitted){
+                return !this->tracker.tracking;
+            }
+            res.calculatedDistance = this->distance(2.0*shape.a,width);
+            res.accuracy = BORDER;
+            direction axis = {(int)std::lround(shape.a*std::cos(shape.angle)),(int)std::lround(shape.a*std::sin(shape.angle))};
+            point center = {(uint32_t)shape.cx,(uint32_t)shape.cy};
+            this->tracker.update(extent,center+direction{-axis.dx,-axis.dy},center+axis,false);
+            return true;
+        }
+        // Outer edge of the border as subpixel samples from the arena, taken within EDGE_DISTANCE of
+        // the ellipse through the row ends. Only edges that get lighter away from the centre are
+        // kept, which leaves out the border's inner edge against the darker pad. False if too few
+        // are found.
+        bool edgeSamples(const rgba *pixels, uint32_t width, uint32_t height, uint32_t stride, const bounds::box &extent, const conic::ellipse &shape, const conic::sample *&samples, size_t &count){
+            bounds::box window = {{extent.min.x > 2 ? extent.min.x-2 : 0,extent.min.y > 2 ? extent.min.y-2 : 0},
+                {std::min(extent.max.x+2,width-1),std::min(extent.max.y+2,height-1)}};
+            ArenaArray<edges::edge> found;
+            this->edgeFinder.run(pixels,stride,window,EDGE_THRESHOLD,*this->arena,found);
+            double c = std::cos(shape.angle), s = std::sin(shape.angle);
+            conic::sample *outer = this->arena->allocate<conic::sample>(found.count);
+            count = 0;
+            for(size_t i=0;i<found.count;++i){
+                const edges::edge &e = found.data[i];
+                double dx = e.x-shape.cx, dy = e.y-shape.cy;
+                if(e.gx*dx + e.gy*dy <= 0.0){
+                    continue;
+                }
+                // r is 1 on the ellipse, which the ray from the centre through the edge meets
+                // |d|/r from the centre
+                double u = (dx*c + dy*s)/shape.a, v = (dy*c - dx*s)/shape.b;
+                double r = std::sqrt(u*u + v*v), d = std::sqrt(dx*dx + dy*dy);
+                if(std::abs(d - d/r) <= EDGE_DISTANCE){
+                    outer[count++] = {e.x,e.y};
+                }
+            }
+            samples = outer;
+            return count >= 6;
+        }
+        // Scale of the largest pad in the search window from correlating its mask with ellipse
+        // templates. False if the pad may continue past a tracked window.
+        bool correlate(const rgba *pixels, uint32_t width, uint32_t height, uint32_t stride, Detection &res){
+            bounds::box window = {{0,0},{width-1,height-1}};
+            uint32_t levels = this->config.pyramidLevels;
+            if(this->tracker.tracking){
+                window = this->tracker.window(width,height);
+            }else if(levels > 0){
+                PROFILE_SCOPE(PYRAMID);
+                this->pyr.build(pixels,width,height,stride,levels,*this->arena,this->analyzer.pool);
+                this->pyr.prepare(levels);
+                bounds::box located;
+                if(pyramid::find(this->pyr,levels,this->borderRange,this->padRange,located)){
+                    window = pyramid::frame(this->pyr,levels,located,2u << levels);
+                }
+            }
+            res = Detection();
+            this->analyzer.run(pixels,stride,window,this->borderRange,this->padRange,&this->borderMask,&this->padMask,this->analysed);
+            const components::component *pad = this->analysed.found ? this->largestPad(this->borderMask,this->padMask) : nullptr;
+            if(!pad){
+                return !this->tracker.tracking;
+            }
+            const bounds::box &extent = pad->extent;
+            if(this->tracker.tracking && ((extent.min.x == window.min.x && window.min.x > 0) || (extent.min.y == window.min.y && window.min.y > 0)
+                || (extent.max.x == window.max.x && window.max.x < width-1) || (extent.max.y == window.max.y && window.max.y < height-1))){
+                return false;
+            }
+            uint32_t dx = extent.max.x - extent.min.x;
+            uint32_t dy = extent.max.y - extent.min.y;
+            if(dx == 0 || dy == 0){
+                return !this->tracker.tracking;
+            }
+            res.accuracy = BOUNDS;
+            res.calculatedDistance = this->distance(std::max(dx,dy),width);
+
+            // The templates' spectra take a while, only engines that use them pay for it
+            if(!this->correlator){
+                this->correlator = std::make_unique<correlate::Correlator>();
+            }
+            correlate::estimate shape;
+            bool matched;
+            {
+                PROFILE_SCOPE(CORRELATE);
+                matched = this->correlator->run(this->borderMask,this->padMask,*pad,shape) && shape.score >= correlate::MIN_SCORE;
+            }
+            if(!matched){
+                this->measureMoments(extent,width,res);
+                return !this->tracker.tracking;
+            }
+            res.calculatedDistance = this->distance(2.0*shape.a,width);
+            res.accuracy = BORDER;
+            direction axis = {(int)std::lround(shape.a*std::cos(shape.angle)),(int)std::lround(shape.a*std::sin(shape.angle))};
+            point center = {(uint32_t)shape.cx,(uint32_t)shape.cy};
+            this->tracker.update(extent,center+direction{-axis.dx,-axis.dy},center+axis,false);
+            return true;
+        }
+        void snapshot(ImageView &view){
+            if(this->snapshots){
+                this->snapshots->push(view);
+            }else{
+                view.save("landing_pad");
+            }
+        }
+        static point frame(const ImageView &view, point p){
+            return {view.origin.x+p.x,view.origin.y+p.y};
+        }
+        static point local(const ImageView &view, point p){
+            return {
+                std::min(p.x-std::min(p.x,view.origin.x),(uint32_t)view.width-1),
+                std::min(p.y-std::min(p.y,view.origin.y),(uint32_t)view.height-1)
+            };
+        }
+        simd::ColorRange borderRange, padRange;
+        yuv::Range borderYuvRange, padYuvRange;
+        ColorMask borderMask, padMask;
+        analysis::Analyzer analyzer;
+        moments::Accumulator accumulator;
+        edges::Extractor edgeFinder;
+        pyramid::Pyramid pyr;
+        ColorMask coarseBorder, coarsePad;
+        analysis::result coarseResult;
+        components::Labeler labeler;
+        std::unique_ptr<correlate::Correlator> correlator;
+    };
+
+    void print(std::ostream &out, const Detection &detection, double lenActual){
+        switch(detection.accuracy){
+            case -1:break;
+            case NONE:{
+                out << "Distance (calculated/actual): NA / " << lenActual << '\n';
+            }break;
+            case BOUNDS:{
+                out << "Distance (calculated/actual): " << detection.calculatedDistance << " / " << lenActual << " +-100%" << '\n';
+            }break;
+            case MOMENTS:{
+                out << "Distance (calculated/actual): " << detection.calculatedDistance << " / " << lenActual << " +-15%" << '\n';
+            }break;
+            case BORDER:{
+                out << "Distance (calculated/actual): " << detection.calculatedDistance << " / " << lenActual << '\n';
+            }
+        }
+    }
+    void print(const Detection &detection, double lenActual){
+        print(std::cout,detection,lenActual);
+        std::cout.flush();
+    }
+}
@@ -0,0 +1,221 @@
+#pragma once
+
+#include <cstdint>
+#include <cmath>
+#include <algorithm>
+#include <vector>
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#endif
+
+#include "image.h"
+#include "mask.h"
+#include "bounds.h"
+#include "arena.h"
+#include "thread_pool.h"
+#include "profiler.h"
+
+// Edges of the luminance of a window with subpixel positions. Sobel gradients are suppressed to
+// their maxima across the edge, and each maximum is moved to the vertex of the parabola through
+// its magnitude and its two neighbours along the gradient. Unlike a colour match the position
+// moves smoothly with the pad instead of in whole pixels, which matters most when the pad is only
+// tens of pixels across.
+namespace edges{
+    struct edge{
+        // Frame coordinates, pixel centres at index + 0.5
+        float x, y;
+        // Sobel gradient, pointing from dark to light, 4 per step of 1 in 0..255
+        int16_t gx, gy;
+    };
+
+    // Luminance in 0..255*32, (38r+75g+15b)/4 with Rec. 601 weights in 7 bits. The scale keeps
+    // Sobel sums in 16 bits.
+    inline void luminance(const rgba *row, uint32_t count, int16_t *out){
+        uint32_t x = 0;
+#if defined(__AVX2__)
+        const __m256i weights = _mm256_set1_epi32(0x000f4b26), ones = _mm256_set1_epi16(1);
+        for(;x+16<=count;x+=16){
+            // Byte pairs multiplied and added, then the two pairs of a pixel
+            __m256i a = _mm256_srai_epi32(_mm256_madd_epi16(_mm256_maddubs_epi16(_mm256_loadu_si256((const __m256i*)(row+x)),weights),ones),2);
+            __m256i b = _mm256_srai_epi32(_mm256_madd_epi16(_mm256_maddubs_epi16(_mm256_loadu_si256((const __m256i*)(row+x+8)),weights),ones),2);
+            // packs interleaves the 128 bit halves of a and b
+            __m256i y = _mm256_permute4x64_epi64(_mm256_packs_epi32(a,b),0xd8);
+            _mm256_storeu_si256((__m256i*)(out+x),y);
+        }
+#endif
+        for(;x<count;++x){
+            out[x] = (38*row[x].r + 75*row[x].g + 15*row[x].b) >> 2;
+        }
+    }
+
+    class Extractor{
+    public:
+        ThreadPool *pool;
+        // Gradient maxima of the last run, one bit per pixel of the window
+        ColorMask maxima;
+        Extractor(ThreadPool *pool = nullptr){
+            this->pool = pool;
+            this->bands.resize(RowBands::most(pool));
+        }
+        // Edges in window with a gradient of at least threshold, in luminance units of one pixel
+        // step, in row order. The outermost pixels of the window have no gradient. Scratch planes
+        // and the result come from arena.
+        void run(const rgba *pixels, uint32_t stride, const bounds::box &window, uint32_t threshold, Arena &arena, ArenaArray<edge> &res){
+            PROFILE_SCOPE(EDGES);
+            uint32_t width = window.max.x-window.min.x+1, height = window.max.y-window.min.y+1;
+            res = {nullptr,0};
+            this->maxima.resize(window.min.x,window.min.y,width,height);
+            std::fill(this->maxima.words.begin(),this->maxima.words.end(),0);
+            if(width < 3 || height < 3){
+                return;
+            }
+            int16_t *luma = arena.allocate<int16_t>((size_t)width*height);
+            int32_t *magnitude = arena.allocate<int32_t>((size_t)width*height);
+            // A step of threshold in 0..255 is a Sobel response of 4*32*threshold, which
+            // gradientRow squares and divides by 16
+            int32_t limit = 1024*std::min(threshold,255u)*std::min(threshold,255u);
+
+            RowBands rows(this->pool,height);
+            rows.run([&](uint32_t, uint32_t y0, uint32_t y1){
+                for(uint32_t y=y0;y<y1;++y){
+                    luminance(pixels+(window.min.y+y)*stride+window.min.x,width,luma+y*width);
+                }
+            });
+            rows.run([&](uint32_t, uint32_t y0, uint32_t y1){
+                for(uint32_t y=y0;y<y1;++y){
+                    gradientRow(luma,width,height,y,magnitude+y*width);
+                }
+            });
+            rows.run([&](uint32_t i, uint32_t y0, uint32_t y1){
+                this->bands[i] = 0;
+                for(uint32_t y=std::max(y0,1u);y<std::min(y1,height-1);++y){
+                    this->bands[i] += suppressRow(luma,magnitude,width,y,limit,this->maxima.row(window.min.y+y));
+                }
+            });
+            size_t total = 0;
+            for(uint32_t i=0;i<rows.size();++i){
+                size_t count = this->bands[i];
+                this->bands[i] = total;
+                total += count;
+            }
+            res = {arena.allocate<edge>(total),total};
+            rows.run([&](uint32_t i, uint32_t y0, uint32_t y1){
+                edge *out = res.data + this->bands[i];
+                for(uint32_t y=std::max(y0,1u);y<std::min(y1,height-1);++y){
+                    const uint64_t *bits = this->maxima.row(window.min.y+y);
+                    for(uint32_t k=0;k<this->maxima.stride;++k){
+                        for(uint64_t w=bits[k];w;w&=w-1){
+                            uint32_t x = 64*k + __builtin_ctzll(w);
+                            *out++ = refine(luma,magnitude,width,x,y,window.min);
+                        }
+                    }
+                }
+            });
+        }
+    private:
+        // Maxima counted per band, then where each band's edges start in the result
+        std::vector<size_t> bands;
+
+        static void sobel(const int16_t *luma, uint32_t width, uint32_t x, uint32_t y, int32_t &gx, int32_t &gy){
+            const int16_t *r0 = luma+(y-1)*width+x, *r1 = r0+width, *r2 = r1+width;
+            gx = (r0[1]-r0[-1]) + 2*(r1[1]-r1[-1]) + (r2[1]-r2[-1]);
+            gy = (r2[-1]+2*r2[0]+r2[1]) - (r0[-1]+2*r0[0]+r0[1]);
+        }
+        // Squared gradient magnitude of row y divided by 16, 0 on the outermost pixels
+        static void gradientRow(const int16_t *luma, uint32_t width, uint32_t height, uint32_t y, int32_t *out){
+            if(y == 0 || y == height-1){
+                std::fill(out,out+width,0);
+                return;
+            }
+            out[0] = 0;
+            out[width-1] = 0;
+            uint32_t x = 1;
+#if defined(__AVX2__)
+            const int16_t *r0 = luma+(y-1)*width, *r1 = r0+width, *r2 = r1+width;
+            for(;x+17<=width;x+=16){
+                auto load = [&](const int16_t *r, int dx){
+                    return _mm256_loadu_si256((const __m256i*)(r+x+dx));
+                };
+                __m256i a0 = load(r0,-1), b0 = load(r0,0), c0 = load(r0,1);
+                __m256i a1 = load(r1,-1), c1 = load(r1,1);
+                __m256i a2 = load(r2,-1), b2 = load(r2,0), c2 = load(r2,1);
+                __m256i gx = _mm256_add_epi16(_mm256_add_epi16(_mm256_sub_epi16(c0,a0),_mm256_sub_epi16(c2,a2)),_mm256_slli_epi16(_mm256_sub_epi16(c1,a1),1));
+                __m256i gy = _mm256_add_epi16(_mm256_add_epi16(_mm256_sub_epi16(a2,a0),_mm256_sub_epi16(c2,c0)),_mm256_slli_epi16(_mm256_sub_epi16(b2,b0),1));
+                // gx^2+gy^2 per pixel from interleaved pairs, which come out in 128 bit halves
+                __m256i lo = _mm256_unpacklo_epi16(gx,gy), hi = _mm256_unpackhi_epi16(gx,gy);
+                lo = _mm256_srli_epi32(_mm256_madd_epi16(lo,lo),4);
+                hi = _mm256_srli_epi32(_mm256_madd_epi16(hi,hi),4);
+                _mm256_storeu_si256((__m256i*)(out+x),_mm256_permute2x128_si256(lo,hi,0x20));
+                _mm256_storeu_si256((__m256i*)(out+x+8),_mm256_permute2x128_si256(lo,hi,0x31));
+            }
+#endif
+            for(;x<width-1;++x){
+                int32_t gx, gy;
+                sobel(luma,width,x,y,gx,gy);
+                out[x] = ((uint32_t)(gx*gx) + (uint32_t)(gy*gy)) >> 4;
+            }
+        }
+        // Neighbour across the edge, the gradient rounded to one of four directions
+        static void across(int32_t gx, int32_t gy, int &dx, int &dy){
+            // tan(22.5 degrees) is about 106/256
+            int32_t ax = std::abs(gx), ay = std::abs(gy);
+            if(256*ay <= 106*ax){
+                dx = 1;
+                dy = 0;
+            }else if(256*ax <= 106*ay){
+                dx = 0;
+                dy = 1;
+            }else{
+                dx = (gx ^ gy) < 0 ? -1 : 1;
+                dy = 1;
+            }
+        }
+        // Sets the bits of the maxima of row y at or above limit, returns how many
+        static size_t suppressRow(const int16_t *luma, const int32_t *magnitude, uint32_t width, uint32_t y, int32_t limit, uint64_t *bits){
+            const int32_t *m = magnitude+y*width;
+            size_t count = 0;
+            uint32_t x = 1;
+            auto test = [&](uint32_t x){
+                int32_t gx, gy;
+                int dx, dy;
+                sobel(luma,width,x,y,gx,gy);
+                across(gx,gy,dx,dy);
+                int offset = dx+dy*(int)width;
+                int32_t before = m[(int)x-offset], after = m[(int)x+offset];
+                // Strictly above one side, so a flat top gives one maximum
+                if(m[x] > before && m[x] >= after){
+                    bits[x >> 6] |= 1ULL << (x & 63);
+                    ++count;
+                }
+            };
+#if defined(__AVX2__)
+            const __m256i vlimit = _mm256_set1_epi32(limit-1);
+            for(;x+8<=width-1;x+=8){
+                int strong = _mm256_movemask_ps(_mm256_castsi256_ps(_mm256_cmpgt_epi32(_mm256_loadu_si256((const __m256i*)(m+x)),vlimit)));
+                for(;strong;strong&=strong-1){
+                    test(x+__builtin_ctz(strong));
+                }
+            }
+#endif
+            for(;x<width-1;++x){
+                if(m[x] >= limit){
+                    test(x);
+                }
+            }
+            return count;
+        }
+        static edge refine(const int16_t *luma, const int32_t *magnitude, uint32_t width, uint32_t x, uint32_t y, point origin){
+            int32_t gx, gy;
+            int dx, dy;
+            sobel(luma,width,x,y,gx,gy);
+            across(gx,gy,dx,dy);
+            const int32_t *m = magnitude+y*width+x;
+            int offset = dx+dy*(int)width;
+            float l = std::sqrt((float)m[-offset]), c = std::sqrt((float)m[0]), r = std::sqrt((float)m[offset]);
+            float d = l - 2.0f*c + r;
+            float t = d < 0.0f ? std::clamp(0.5f*(l-r)/d,-0.5f,0.5f) : 0.0f;
+            return {origin.x+x+0.5f+t*dx,origin.y+y+0.5f+t*dy,(int16_t)(gx/32),(int16_t)(gy/32)};
+        }
+    };
+}
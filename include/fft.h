@@ -0,0 +1,119 @@
+#pragma once
+
+#include <cstdint>
+#include <cmath>
+#include <algorithm>
+#include <complex>
+#include <vector>
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#endif
+
+// Radix-2 fast Fourier transforms for power of two sizes. A Plan holds the bit reversal order and
+// twiddle factors for one size, so a transform does no trigonometry and no allocation.
+namespace fft{
+    typedef std::complex<float> complex;
+
+    // Written out, std::complex's operator* checks for infinities
+    inline complex mul(const complex &a, const complex &b){
+        return complex(a.real()*b.real() - a.imag()*b.imag(),a.real()*b.imag() + a.imag()*b.real());
+    }
+    // a, b = a + w*b, a - w*b for count pairs, with w advancing by wStep. Four pairs at a time with
+    // AVX2, the products from the real and imaginary parts of w combined by addsub.
+    inline void butterflies(complex *a, complex *b, const complex *w, uint32_t wStep, uint32_t count){
+        uint32_t k = 0;
+#if defined(__AVX2__)
+        if(wStep == 0){
+            const __m256 wr = _mm256_set1_ps(w->real()), wi = _mm256_set1_ps(w->imag());
+            for(;k+4<=count;k+=4){
+                __m256 va = _mm256_loadu_ps((float*)(a+k)), vb = _mm256_loadu_ps((float*)(b+k));
+                __m256 t = _mm256_addsub_ps(_mm256_mul_ps(vb,wr),_mm256_mul_ps(_mm256_permute_ps(vb,0xb1),wi));
+                _mm256_storeu_ps((float*)(b+k),_mm256_sub_ps(va,t));
+                _mm256_storeu_ps((float*)(a+k),_mm256_add_ps(va,t));
+            }
+        }else if(wStep == 1){
+            for(;k+4<=count;k+=4){
+                __m256 vw = _mm256_loadu_ps((const float*)(w+k));
+                __m256 va = _mm256_loadu_ps((float*)(a+k)), vb = _mm256_loadu_ps((float*)(b+k));
+                __m256 t = _mm256_addsub_ps(_mm256_mul_ps(vb,_mm256_moveldup_ps(vw)),_mm256_mul_ps(_mm256_permute_ps(vb,0xb1),_mm256_movehdup_ps(vw)));
+                _mm256_storeu_ps((float*)(b+k),_mm256_sub_ps(va,t));
+                _mm256_storeu_ps((float*)(a+k),_mm256_add_ps(va,t));
+            }
+        }
+#endif
+        for(;k<count;++k){
+            complex t = mul(w[k*wStep],b[k]);
+            b[k] = a[k]-t;
+            a[k] = a[k]+t;
+        }
+    }
+
+    class Plan{
+    public:
+        uint32_t n = 0;
+        // n must be a power of two
+        Plan(uint32_t n) : n(n), reversed(n), forward(n), backward(n){
+            uint32_t bits = 0;
+            while((1u << bits) < n){
+                ++bits;
+            }
+            for(uint32_t i=0;i<n;++i){
+                uint32_t r = 0;
+                for(uint32_t b=0;b<bits;++b){
+                    r |= ((i >> b) & 1) << (bits-1-b);
+                }
+                this->reversed[i] = r;
+            }
+            // The stage combining halves of length half uses twiddles[half..2*half)
+            for(uint32_t half=1;half<n;half<<=1){
+                for(uint32_t k=0;k<half;++k){
+                    double angle = -M_PI*k/half;
+                    this->forward[half+k] = complex(std::cos(angle),std::sin(angle));
+                    this->backward[half+k] = std::conj(this->forward[half+k]);
+                }
+            }
+        }
+        // In place. The inverse is not scaled by 1/n.
+        void transform(complex *data, bool inverse) const {
+            for(uint32_t i=0;i<this->n;++i){
+                uint32_t r = this->reversed[i];
+                if(i < r){
+                    std::swap(data[i],data[r]);
+                }
+            }
+            const complex *twiddles = inverse ? this->backward.data() : this->forward.data();
+            for(uint32_t half=1;half<this->n;half<<=1){
+                for(uint32_t i=0;i<this->n;i+=2*half){
+                    butterflies(data+i,data+i+half,twiddles+half,1,half);
+                }
+            }
+        }
+        // n x n values, row major. The column transforms run on whole rows at once, every butterfly
+        // applied across a row pair, so both passes walk contiguous memory.
+        void transform2d(complex *data, bool inverse) const {
+            uint32_t n = this->n;
+            for(uint32_t y=0;y<n;++y){
+                this->transform(data+y*n,inverse);
+            }
+            for(uint32_t y=0;y<n;++y){
+                uint32_t r = this->reversed[y];
+                if(y < r){
+                    std::swap_ranges(data+y*n,data+(y+1)*n,data+r*n);
+                }
+            }
+            const complex *twiddles = inverse ? this->backward.data() : this->forward.data();
+            for(uint32_t half=1;half<n;half<<=1){
+                for(uint32_t i=0;i<n;i+=2*half){
+                    for(uint32_t k=0;k<half;++k){
+                        butterflies(data+(i+k)*n,data+(i+k+half)*n,twiddles+half+k,0,n);
+                    }
+                }
+            }
+        }
+    private:
+        std::vector<uint32_t> reversed;
+        // Twiddle factors of every stage, for each direction
+        std::vector<complex> forward, backward;
+    };
+}
@@ -1,26 +1,64 @@
 #pragma once
 
-#include "graphicsLibrary/include/texture.h"
+#include <cstdint>
+#include <cmath>
+#include <vector>
+#include <algorithm>
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#endif
+
+#include "thread_pool.h"
 
 namespace filter{
-    void circle(graphics::Image &img, uint32_t fill, uint32_t stroke, uint32_t strokeWeight, bool bg, uint32_t bgColor = 0){
+    // Filled circle touching the image edges with a stroke of strokeWeight pixels, background
+    // elsewhere. Squared distances are summed per row from per column and per row terms in double,
+    // exactly as they would be per pixel. Rows are split across the pool.
+    template<typename Image_t>
+    void circle(Image_t &img, uint32_t fill, uint32_t stroke, uint32_t strokeWeight, bool bg, uint32_t bgColor = 0, ThreadPool *pool = nullptr){
         uint32_t *buf = img.buffer32;
         double fs = 0.5*(double)strokeWeight/std::sqrt((double)img.width*(double)img.height);
+        double inner = 1.0-fs;
+        std::vector<double> fw2(img.width);
         for(int i=0;i<img.width;++i){
-            for(int j=0;j<img.height;++j){
-                double fw = 2.0f*(((double)i/(double)img.width) - 0.5f);
+            double fw = 2.0f*(((double)i/(double)img.width) - 0.5f);
+            fw2[i] = fw*fw;
+        }
+        int bands = pool ? std::min<int>(img.height,4*pool->size()) : 1;
+        auto band = [&](int b){
+            for(int j=img.height*b/bands;j<img.height*(b+1)/bands;++j){
                 double fh = 2.0f*(((double)j/(double)img.height) - 0.5f);
-                double r = fw*fw + fh*fh;
-                if(r <= 1.0f){
-                    if(r < 1.0-fs){
-                        buf[i+j*img.width] = fill;
+                double fh2 = fh*fh;
+                uint32_t *row = buf + j*img.width;
+                int i = 0;
+#if defined(__AVX2__)
+                const __m256d vfh2 = _mm256_set1_pd(fh2), one = _mm256_set1_pd(1.0), vinner = _mm256_set1_pd(inner);
+                const __m128i vfill = _mm_set1_epi32(fill), vstroke = _mm_set1_epi32(stroke), vbg = _mm_set1_epi32(bgColor);
+                const __m256i even = _mm256_setr_epi32(0,2,4,6,1,3,5,7);
+                for(;i+4<=img.width;i+=4){
+                    __m256d r = _mm256_add_pd(_mm256_loadu_pd(fw2.data()+i),vfh2);
+                    // 64 bit lane masks narrowed to 32 bit lanes
+                    __m128i onCircle = _mm256_castsi256_si128(_mm256_permutevar8x32_epi32(_mm256_castpd_si256(_mm256_cmp_pd(r,one,_CMP_LE_OQ)),even));
+                    __m128i inside = _mm256_castsi256_si128(_mm256_permutevar8x32_epi32(_mm256_castpd_si256(_mm256_cmp_pd(r,vinner,_CMP_LT_OQ)),even));
+                    __m128i color = _mm_blendv_epi8(vbg,_mm_blendv_epi8(vstroke,vfill,inside),onCircle);
+                    _mm_storeu_si128((__m128i*)(row+i),color);
+                }
+#endif
+                for(;i<img.width;++i){
+                    double r = fw2[i] + fh2;
+                    if(r <= 1.0f){
+                        row[i] = r < inner ? fill : stroke;
                     }else{
-                        buf[i+j*img.width] = stroke;
+                        row[i] = bgColor;
                     }
-                }else{
-                    buf[i+j*img.width] = bgColor;
                 }
             }
+        };
+        if(pool){
+            pool->parallelFor(bands,band);
+        }else{
+            band(0);
         }
         int size = 10;
         for(int i=-size;i<=size;++i){
@@ -29,4 +67,4 @@ namespace filter{
             }
         }
     }
-}
\ No newline at end of file
+}
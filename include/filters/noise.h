@@ -1,34 +1,69 @@
 #pragma once
 
-#include "graphicsLibrary/include/texture.h"
+#include <cstdint>
+#include <cmath>
+#include <vector>
+#include <algorithm>
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#endif
+
 #include "perlin.h"
+#include "thread_pool.h"
 
 namespace filter{
-    void noise(graphics::Image &img, uint32_t mag){
+    // Adds value noise to every channel with a non-zero magnitude. Positive offsets wrap around 255,
+    // negative ones stop at 0. Row x of the buffer samples noise at (x, y) for each column y, rows are
+    // split across the pool. Keep float contraction off (no -mfma or -ffp-contract=off) so the result
+    // matches noise2d evaluated pixel by pixel.
+    template<typename Image_t>
+    void noise(Image_t &img, uint32_t mag, ThreadPool *pool = nullptr){
         uint8_t *buf = img.buffer;
         uint8_t *magCmp = (uint8_t*)&mag;
-        for(int x=0;x<img.width;++x){
-            for(int y=0;y<img.height;++y){
-                int offset = 4*(x*img.height + y);
+        int rows = img.width, cols = img.height;
+        int bands = pool ? std::min<int>(rows,4*pool->size()) : 1;
+        auto band = [&](int b){
+            std::vector<float> n1(cols), n2(cols);
+            std::vector<int8_t> delta(4*cols);
+            for(int x=rows*b/bands;x<rows*(b+1)/bands;++x){
+                std::fill(delta.begin(),delta.end(),0);
                 for(int i=0;i<4;++i){
-                    int index = offset + i;
-                    int8_t d = magCmp[i]*(perlin::noise2d(5*i + x/100.0f,11 * i + y/100.0f) + 0.5f*perlin::noise2d(7*i + 50+x/200.0f,17*i + 50+y/200.0f));
-                    uint8_t current = buf[index];
+                    if(magCmp[i] == 0){
+                        continue;
+                    }
+                    perlin::noise2dRow(5*i + x/100.0f,11*i,100.0f,cols,n1.data());
+                    perlin::noise2dRow(7*i + 50+x/200.0f,17*i + 50,200.0f,cols,n2.data());
+                    for(int y=0;y<cols;++y){
+                        delta[4*y+i] = magCmp[i]*(n1[y] + 0.5f*n2[y]);
+                    }
+                }
+                uint8_t *row = buf + 4*x*cols;
+                int y = 0;
+#if defined(__AVX2__)
+                for(;y+32<=4*cols;y+=32){
+                    __m256i d = _mm256_loadu_si256((const __m256i*)(delta.data()+y));
+                    __m256i current = _mm256_loadu_si256((const __m256i*)(row+y));
+                    __m256i up = _mm256_add_epi8(current,d);
+                    __m256i down = _mm256_subs_epu8(current,_mm256_sub_epi8(_mm256_setzero_si256(),d));
+                    __m256i negative = _mm256_cmpgt_epi8(_mm256_setzero_si256(),d);
+                    _mm256_storeu_si256((__m256i*)(row+y),_mm256_blendv_epi8(up,down,negative));
+                }
+#endif
+                for(;y<4*cols;++y){
+                    int8_t d = delta[y];
                     if(d<0){
-                        if(abs(d)>=current){
-                            buf[index] = 0;
-                        }else{
-                            buf[index] += d;
-                        }
+                        row[y] = std::max((int)row[y]+d,0);
                     }else{
-                        if(d+current < current){
-                            buf[index] = 255;
-                        }else{
-                            buf[index] += d;
-                        }
+                        row[y] += d;
                     }
                 }
             }
+        };
+        if(pool){
+            pool->parallelFor(bands,band);
+        }else{
+            band(0);
         }
     }
-}
\ No newline at end of file
+}
@@ -2,12 +2,18 @@
 
 #include <cstdint>
 #include <cmath>
+#include <cstring>
 #include <iostream>
 #include <filesystem>
+#include <algorithm>
 
 #define STB_IMAGE_WRITE_IMPLEMENTATION
 #include "stb/stb_image_write.h"
 
+#include "mask.h"
+#include "profiler.h"
+#include "arena.h"
+
 struct rgba{
     uint8_t r, g, b, a;
     operator const uint32_t() const {return *(const uint32_t*)this;}
@@ -18,66 +24,165 @@ struct rgba{
 };
 struct direction{
     int dx, dy;
-    float magSq(){
+    float magSq() const {
         return this->dx*this->dx + this->dy*this->dy;
     }
 };
 struct point{
     uint32_t x, y;
-    point operator+(direction d){
+    point operator+(direction d) const {
         return {(uint32_t)std::max(((int)this->x)+d.dx,0),(uint32_t)std::max(((int)this->y)+d.dy,0)};
     }
-    direction operator-(point p){
+    direction operator-(point p) const {
         return {(int)this->x-(int)p.x,(int)this->y-(int)p.y};
     }
 };
 
-class Image{
+// Little endian packing of a color, usable in constant expressions
+constexpr uint32_t pack(rgba c){
+    return (uint32_t)c.r | (uint32_t)c.g << 8 | (uint32_t)c.b << 16 | (uint32_t)c.a << 24;
+}
+
+// Pixel tests for the ImageView search routines
+namespace match{
+    // Color and tolerance given at runtime, rgba::equals with full alpha tolerance
+    struct Color{
+        rgba color;
+        int tolerance;
+        bool operator()(rgba c) const {
+            return c.equals(this->color,this->tolerance,this->tolerance,this->tolerance);
+        }
+    };
+    // Color and tolerance known at compile time, the same test folded into one unsigned compare per
+    // channel. Channels whose bounds cover 0-255 drop out entirely.
+    template<uint32_t COLOR, int TOLERANCE>
+    struct Const{
+        static constexpr int lo(int shift, int tolerance){
+            return std::max(0,(int)((COLOR >> shift) & 255) - tolerance + 1);
+        }
+        static constexpr int hi(int shift, int tolerance){
+            return std::min(255,(int)((COLOR >> shift) & 255) + tolerance - 1);
+        }
+        static constexpr bool inside(uint8_t c, int shift, int tolerance){
+            return tolerance > 0 && (uint32_t)(c - lo(shift,tolerance)) <= (uint32_t)(hi(shift,tolerance) - lo(shift,tolerance));
+        }
+        bool operator()(rgba c) const {
+            return inside(c.r,0,TOLERANCE) && inside(c.g,8,TOLERANCE) && inside(c.b,16,TOLERANCE) && inside(c.a,24,255);
+        }
+    };
+}
+// What the search routines do with every pixel they pass over
+namespace annotate{
+    struct None{
+        template<typename View>
+        void operator()(View&, point) const {}
+    };
+    struct Color{
+        rgba color;
+        template<typename View>
+        void operator()(View &view, point p) const {
+            view.annotatePixel(p,this->color);
+        }
+    };
+}
+
+// Non-owning window into a frame. Annotations go to a separate copy that is only made once
+// something is actually annotated, taken from arena when one is given.
+class ImageView{
 public:
-    rgba *pixels;
-    rgba *annotated;
+    const rgba *pixels;
+    rgba *annotated = nullptr;
     int width, height;
-    Image(rgba *pixels, point p1, point p2, int srcWidth){
+    int stride;
+    point origin;
+    ImageView(const rgba *pixels, point p1, point p2, int srcWidth, Arena *arena = nullptr) : arena(arena){
         int minX = std::min(p1.x,p2.x);
         int minY = std::min(p1.y,p2.y);
         int maxX = std::max(p1.x,p2.x);
         int maxY = std::max(p1.y,p2.y);
-        int dx = maxX-minX;
-        int dy = maxY-minY;
-
-        this->width = dx;
-        this->height = dy;
-
-        this->pixels = new rgba[dx*dy];
-        this->annotated = new rgba[dx*dy];
 
-        for(int y=0;y<dy;++y){
-            memcpy(this->pixels+y*dx,pixels+(y+minY)*srcWidth+minX,dx*4);
-        }
-        memcpy(this->annotated,this->pixels,dx*dy*sizeof(rgba));
+        this->width = maxX-minX;
+        this->height = maxY-minY;
+        this->stride = srcWidth;
+        this->origin = {(uint32_t)minX,(uint32_t)minY};
+        this->pixels = pixels + minY*srcWidth + minX;
     }
-    ~Image(){
-        delete[] this->pixels;
-        delete[] this->annotated;
+    ImageView(const ImageView&) = delete;
+    ImageView &operator=(const ImageView&) = delete;
+    ~ImageView(){
+        if(!this->arena){
+            delete[] this->annotated;
+        }
     }
     rgba getPixel(point p){
-        return this->pixels[p.x + this->width * p.y];
+        return this->pixels[p.x + this->stride * p.y];
     }
     bool pixelEq(point p,rgba color, int tolerance){
         return this->getPixel(p).equals(color,tolerance,tolerance,tolerance);
     }
+    bool pixelEq(point p, const ColorMask &mask){
+        return mask.test(this->origin.x+p.x,this->origin.y+p.y);
+    }
     void annotatePixel(point p, rgba color){
         if(color.a > 0){
+            if(!this->annotated){
+                size_t size = (size_t)this->width*this->height;
+                this->annotated = this->arena ? this->arena->allocate<rgba>(size) : new rgba[size];
+                for(int y=0;y<this->height;++y){
+                    memcpy(this->annotated+y*this->width,this->pixels+y*this->stride,this->width*sizeof(rgba));
+                }
+            }
             this->annotated[p.x + this->width * p.y] = color;
         }
     }
     bool inRange(point p){
         return p.x < this->width && p.y < this->height;
     }
+    // The search routines take a matcher, anything from the match namespace, and an annotation
+    // policy. The overloads taking colors keep the runtime interface.
+    template<typename Match, typename Annotate>
+    bool linearSearch(point start, direction dPos, point &res, const Match &match, const Annotate &annotate){
+        PROFILE_SCOPE(LINEAR_SEARCH);
+        PROFILE_TALLY(LINEAR_SEARCH_STEPS,steps);
+        res = start;
+        while(!match(this->getPixel(res))){
+            PROFILE_TICK(steps,1);
+            annotate(*this,res);
+            res = res + dPos;
+            if(!this->inRange(res)){
+                return false;
+            }
+        }
+        return true;
+    }
     bool linearSearch(point start, direction dPos, point &res, rgba color, int tolerance, rgba annotationColor = {255,0,0,255}){
+        return this->linearSearch(start,dPos,res,match::Color{color,tolerance},annotate::Color{annotationColor});
+    }
+    template<typename Annotate>
+    bool linearSearch(point start, direction dPos, point &res, const ColorMask &mask, const Annotate &annotate){
+        PROFILE_SCOPE(LINEAR_SEARCH);
+        PROFILE_TALLY(LINEAR_SEARCH_STEPS,steps);
         res = start;
-        while(!getPixel(res).equals(color,tolerance,tolerance,tolerance)){
-            this->annotatePixel(res,annotationColor);
+        if(dPos.dy == 0 && (dPos.dx == 1 || dPos.dx == -1) && this->inRange(start)){
+            // Horizontal searches skip a word at a time
+            uint32_t y = this->origin.y+start.y;
+            uint32_t x = this->origin.x+start.x;
+            uint32_t begin = this->origin.x, end = this->origin.x+this->width;
+            uint32_t found = dPos.dx > 0 ? mask.find(y,x,end,true) : mask.rfind(y,begin,x+1,true);
+            bool hit = dPos.dx > 0 ? found != end : found != x+1;
+            uint32_t stop = hit ? found : (dPos.dx > 0 ? end : begin-1);
+            PROFILE_TICK(steps,dPos.dx > 0 ? stop-x : x-stop);
+            for(uint32_t i=x;i!=stop;i+=dPos.dx){
+                annotate(*this,{i-this->origin.x,start.y});
+            }
+            if(hit){
+                res.x = found-this->origin.x;
+            }
+            return hit;
+        }
+        while(!this->pixelEq(res,mask)){
+            PROFILE_TICK(steps,1);
+            annotate(*this,res);
             res = res + dPos;
             if(!this->inRange(res)){
                 return false;
@@ -85,25 +190,68 @@ public:
         }
         return true;
     }
-    bool xDirOfMax(point p, bool &pxIsMax, rgba padColor, rgba borderColor, int tolerance, rgba annotateColor = {255,255,0,255}){
+    bool linearSearch(point start, direction dPos, point &res, const ColorMask &mask, rgba annotationColor = {255,0,0,255}){
+        return this->linearSearch(start,dPos,res,mask,annotate::Color{annotationColor});
+    }
+    template<typename PadMatch, typename BorderMatch, typename Annotate>
+    bool xDirOfMax(point p, bool &pxIsMax, const PadMatch &pad, const BorderMatch &border, const Annotate &annotate){
+        PROFILE_SCOPE(X_DIR_OF_MAX);
         // Cannot be determined if too close to edge
         if(p.y <= 1 || p.y >= this->height-2){
             return false;
         }
         uint32_t y = p.y;
         for(uint32_t x=p.x+1;x<this->width;++x){
-            if(this->getPixel({x,y}).equals(borderColor,tolerance,tolerance,tolerance)){
+            if(border(this->getPixel({x,y}))){
                 pxIsMax = false;
                 return true;
-            }else if(this->getPixel({x,y+1}).equals(padColor,tolerance,tolerance,tolerance) && this->getPixel({x,y-1}).equals(padColor,tolerance,tolerance,tolerance)){
+            }else if(pad(this->getPixel({x,y+1})) && pad(this->getPixel({x,y-1}))){
                 pxIsMax = true;
                 return true;
             }
-            this->annotatePixel({x,y},annotateColor);
+            annotate(*this,{x,y});
         }
         return false;
     }
-    bool traceBorder(point start, point center, bool ccw, bool findMin, uint32_t checks, point &res, float &radiusSq, rgba borderColor, int tolerance, rgba annotateColor = {255,0,255,255}){
+    bool xDirOfMax(point p, bool &pxIsMax, rgba padColor, rgba borderColor, int tolerance, rgba annotateColor = {255,255,0,255}){
+        return this->xDirOfMax(p,pxIsMax,match::Color{padColor,tolerance},match::Color{borderColor,tolerance},annotate::Color{annotateColor});
+    }
+    // Border and pad masks must come from the same classification so their words line up
+    template<typename Annotate>
+    bool xDirOfMax(point p, bool &pxIsMax, const ColorMask &padMask, const ColorMask &borderMask, const Annotate &annotate){
+        PROFILE_SCOPE(X_DIR_OF_MAX);
+        // Cannot be determined if too close to edge
+        if(p.y <= 1 || p.y >= this->height-2){
+            return false;
+        }
+        uint32_t y = this->origin.y+p.y;
+        uint32_t begin = this->origin.x+p.x+1, end = this->origin.x+this->width;
+        const uint64_t *border = borderMask.row(y), *above = padMask.row(y-1), *below = padMask.row(y+1);
+        uint32_t found = end;
+        for(uint32_t rel = begin-borderMask.x0;rel < end-borderMask.x0;rel = (rel & ~63u) + 64){
+            uint32_t k = rel>>6;
+            uint64_t w = (border[k] | (above[k] & below[k])) & (~0ULL << (rel&63));
+            if(w){
+                found = std::min(end,(rel & ~63u) + __builtin_ctzll(w) + borderMask.x0);
+                break;
+            }
+        }
+        for(uint32_t x=begin;x<found;++x){
+            annotate(*this,{x-this->origin.x,p.y});
+        }
+        if(found == end){
+            return false;
+        }
+        pxIsMax = !borderMask.test(found,y);
+        return true;
+    }
+    bool xDirOfMax(point p, bool &pxIsMax, const ColorMask &padMask, const ColorMask &borderMask, rgba annotateColor = {255,255,0,255}){
+        return this->xDirOfMax(p,pxIsMax,padMask,borderMask,annotate::Color{annotateColor});
+    }
+    template<typename Match, typename Annotate>
+    bool traceBorder(point start, point center, bool ccw, bool findMin, uint32_t checks, point &res, float &radiusSq, const Match &border, const Annotate &annotate){
+        PROFILE_SCOPE(TRACE_BORDER);
+        PROFILE_TALLY(TRACE_STEPS,steps);
         if(checks == 0 || !this->inRange(center)){
             return false;
         }
@@ -113,10 +261,11 @@ public:
             radiusSq = 0;
         }
         for(int count = 0;count <= checks;++count){
+            PROFILE_TICK(steps,1);
             if(!this->inRange(start)){
                 return false;
             }
-            this->annotatePixel(start,annotateColor);
+            annotate(*this,start);
             //Check current point
             direction delta = start-center;
             float rSq = delta.magSq();
@@ -129,35 +278,105 @@ public:
             if(std::abs(delta.dx)*this->height > std::abs(delta.dy)*this->width){
                 // Left or right of screen
                 start.y -= ((delta.dx>0)==ccw)?-1:1;
-                if(this->pixelEq(start,borderColor,tolerance)){
+                if(this->inRange(start) && border(this->getPixel(start))){
                     do{
                         start.x += delta.dy>0 ? -1:1;
-                    }while(this->pixelEq(start,borderColor,tolerance));
-                }else{
+                    }while(this->inRange(start) && border(this->getPixel(start)));
+                }else if(this->inRange(start)){
                     do{
                         start.x -= delta.dy>0 ? -1:1;
-                    }while(!this->pixelEq(start,borderColor,tolerance));
-                    start.x += delta.dy>0 ? -1:1;
+                    }while(this->inRange(start) && !border(this->getPixel(start)));
+                    if(this->inRange(start)){
+                        start.x += delta.dy>0 ? -1:1;
+                    }
                 }
             }else{
                 // Top or bottom of screen
                 start.x += ((delta.dy>0)==ccw)?-1:1;
-                if(this->pixelEq(start,borderColor,tolerance)){
+                if(this->inRange(start) && border(this->getPixel(start))){
                     do{
                         start.y += delta.dy>0 ? -1:1;
-                    }while(this->pixelEq(start,borderColor,tolerance));
-                }else{
+                    }while(this->inRange(start) && border(this->getPixel(start)));
+                }else if(this->inRange(start)){
                     do{
                         start.y -= delta.dy>0 ? -1:1;
-                    }while(!this->pixelEq(start,borderColor,tolerance));
-                    start.y += delta.dy>0 ? -1:1;
+                    }while(this->inRange(start) && !border(this->getPixel(start)));
+                    if(this->inRange(start)){
+                        start.y += delta.dy>0 ? -1:1;
+                    }
                 }
             }
         }
         return true;
     }
+    bool traceBorder(point start, point center, bool ccw, bool findMin, uint32_t checks, point &res, float &radiusSq, rgba borderColor, int tolerance, rgba annotateColor = {255,0,255,255}){
+        return this->traceBorder(start,center,ccw,findMin,checks,res,radiusSq,match::Color{borderColor,tolerance},annotate::Color{annotateColor});
+    }
+    template<typename Annotate>
+    bool traceBorder(point start, point center, bool ccw, bool findMin, uint32_t checks, point &res, float &radiusSq, const ColorMask &border, const Annotate &annotate){
+        PROFILE_SCOPE(TRACE_BORDER);
+        PROFILE_TALLY(TRACE_STEPS,steps);
+        if(checks == 0 || !this->inRange(center)){
+            return false;
+        }
+        if(findMin){
+            radiusSq = this->width*this->width*this->height*this->height;
+        }else{
+            radiusSq = 0;
+        }
+        for(int count = 0;count <= checks;++count){
+            PROFILE_TICK(steps,1);
+            if(!this->inRange(start)){
+                return false;
+            }
+            annotate(*this,start);
+            //Check current point
+            direction delta = start-center;
+            float rSq = delta.magSq();
+            if((rSq <= radiusSq) == findMin){
+                count = 0;
+                radiusSq = rSq;
+                res = start;
+            }
+            //Find next point
+            int sx = 0, sy = 0;
+            if(std::abs(delta.dx)*this->height > std::abs(delta.dy)*this->width){
+                // Left or right of screen
+                start.y -= ((delta.dx>0)==ccw)?-1:1;
+                sx = delta.dy>0 ? -1:1;
+            }else{
+                // Top or bottom of screen
+                start.x += ((delta.dy>0)==ccw)?-1:1;
+                sy = delta.dy>0 ? -1:1;
+            }
+            uint32_t x = this->origin.x+start.x, y = this->origin.y+start.y;
+            bool found;
+            if(border.test(x,y)){
+                found = border.walk(x,y,sx,sy,false);
+            }else{
+                found = border.walk(x,y,-sx,-sy,true);
+                x += sx;
+                y += sy;
+            }
+            if(found){
+                start = {x-this->origin.x,y-this->origin.y};
+            }else{
+                start = {(uint32_t)this->width,(uint32_t)this->height};
+            }
+        }
+        return true;
+    }
+    bool traceBorder(point start, point center, bool ccw, bool findMin, uint32_t checks, point &res, float &radiusSq, const ColorMask &border, rgba annotateColor = {255,0,255,255}){
+        return this->traceBorder(start,center,ccw,findMin,checks,res,radiusSq,border,annotate::Color{annotateColor});
+    }
     void save(std::string fname){
-        stbi_write_png((fname+".png").c_str(),this->width,this->height,4,this->pixels,4*this->width);
-        stbi_write_png((fname+"_annotated.png").c_str(),this->width,this->height,4,this->annotated,4*this->width);
+        stbi_write_png((fname+".png").c_str(),this->width,this->height,4,this->pixels,4*this->stride);
+        if(this->annotated){
+            stbi_write_png((fname+"_annotated.png").c_str(),this->width,this->height,4,this->annotated,4*this->width);
+        }else{
+            stbi_write_png((fname+"_annotated.png").c_str(),this->width,this->height,4,this->pixels,4*this->stride);
+        }
     }
+private:
+    Arena *arena;
 };
\ No newline at end of file
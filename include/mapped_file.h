@@ -0,0 +1,107 @@
+#pragma once
+
+#include <cstdint>
+#include <cstddef>
+#include <filesystem>
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#endif
+
+// Whole file mapped copy-on-write: pages are shared with the page cache until written, and writes
+// never reach the file.
+class MappedFile{
+public:
+    MappedFile() = default;
+    MappedFile(const MappedFile&) = delete;
+    MappedFile &operator=(const MappedFile&) = delete;
+    MappedFile(MappedFile &&other){
+        *this = std::move(other);
+    }
+    MappedFile &operator=(MappedFile &&other){
+        if(this != &other){
+            this->close();
+            this->bytes = other.bytes;
+            this->length = other.length;
+            other.bytes = nullptr;
+            other.length = 0;
+        }
+        return *this;
+    }
+    ~MappedFile(){
+        this->close();
+    }
+    // False if the file cannot be opened or is empty
+    bool open(const std::filesystem::path &path){
+        this->close();
+#ifdef _WIN32
+        HANDLE file = CreateFileW(path.c_str(),GENERIC_READ,FILE_SHARE_READ,nullptr,OPEN_EXISTING,FILE_ATTRIBUTE_NORMAL,nullptr);
+        if(file == INVALID_HANDLE_VALUE){
+            return false;
+        }
+        LARGE_INTEGER size;
+        if(!GetFileSizeEx(file,&size) || size.QuadPart == 0){
+            CloseHandle(file);
+            return false;
+        }
+        HANDLE mapping = CreateFileMappingW(file,nullptr,PAGE_WRITECOPY,0,0,nullptr);
+        CloseHandle(file);
+        if(!mapping){
+            return false;
+        }
+        void *view = MapViewOfFile(mapping,FILE_MAP_COPY,0,0,0);
+        CloseHandle(mapping);
+        if(!view){
+            return false;
+        }
+        this->bytes = (uint8_t*)view;
+        this->length = size.QuadPart;
+#else
+        int fd = ::open(path.c_str(),O_RDONLY);
+        if(fd < 0){
+            return false;
+        }
+        struct stat st;
+        if(fstat(fd,&st) != 0 || st.st_size == 0){
+            ::close(fd);
+            return false;
+        }
+        void *view = mmap(nullptr,st.st_size,PROT_READ | PROT_WRITE,MAP_PRIVATE,fd,0);
+        ::close(fd);
+        if(view == MAP_FAILED){
+            return false;
+        }
+        this->bytes = (uint8_t*)view;
+        this->length = st.st_size;
+#endif
+        return true;
+    }
+    void close(){
+        if(!this->bytes){
+            return;
+        }
+#ifdef _WIN32
+        UnmapViewOfFile(this->bytes);
+#else
+        munmap(this->bytes,this->length);
+#endif
+        this->bytes = nullptr;
+        this->length = 0;
+    }
+    uint8_t *data() const {
+        return this->bytes;
+    }
+    size_t size() const {
+        return this->length;
+    }
+private:
+    uint8_t *bytes = nullptr;
+    size_t length = 0;
+};
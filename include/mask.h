@@ -0,0 +1,106 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+// One bit per pixel, rows padded to whole 64 bit words. Coordinates are frame coordinates,
+// bit 0 of the first word is pixel (x0,y0).
+class ColorMask{
+public:
+    std::vector<uint64_t> words;
+    uint32_t x0 = 0, y0 = 0;
+    uint32_t width = 0, height = 0;
+    uint32_t stride = 0;
+    void resize(uint32_t x0, uint32_t y0, uint32_t width, uint32_t height){
+        this->x0 = x0;
+        this->y0 = y0;
+        this->width = width;
+        this->height = height;
+        this->stride = (width+63)/64;
+        this->words.resize(this->stride*height);
+    }
+    // Room for masks up to width x height without reallocating
+    void reserve(uint32_t width, uint32_t height){
+        this->words.reserve((size_t)((width+63)/64)*height);
+    }
+    uint64_t *row(uint32_t y){
+        return this->words.data() + (y-this->y0)*this->stride;
+    }
+    const uint64_t *row(uint32_t y) const {
+        return this->words.data() + (y-this->y0)*this->stride;
+    }
+    bool test(uint32_t x, uint32_t y) const {
+        uint32_t rx = x-this->x0, ry = y-this->y0;
+        if(rx >= this->width || ry >= this->height){
+            return false;
+        }
+        return (this->words[ry*this->stride + (rx>>6)] >> (rx&63)) & 1;
+    }
+    // First x in [begin,end) of row y whose bit equals value, or end
+    uint32_t find(uint32_t y, uint32_t begin, uint32_t end, bool value) const {
+        const uint64_t *r = this->row(y);
+        uint32_t rel = begin-this->x0, relEnd = end-this->x0;
+        uint64_t flip = value ? 0 : ~0ULL;
+        while(rel < relEnd){
+            uint64_t w = (r[rel>>6] ^ flip) & (~0ULL << (rel&63));
+            if(w){
+                uint32_t res = (rel & ~63u) + __builtin_ctzll(w);
+                return res < relEnd ? res+this->x0 : end;
+            }
+            rel = (rel & ~63u) + 64;
+        }
+        return end;
+    }
+    // Last x in [begin,end) of row y whose bit equals value, or end
+    uint32_t rfind(uint32_t y, uint32_t begin, uint32_t end, bool value) const {
+        if(end <= begin){
+            return end;
+        }
+        const uint64_t *r = this->row(y);
+        uint32_t rel = end-1-this->x0, relBegin = begin-this->x0;
+        uint64_t flip = value ? 0 : ~0ULL;
+        while(true){
+            uint64_t w = (r[rel>>6] ^ flip) & (~0ULL >> (63-(rel&63)));
+            if(w){
+                uint32_t res = (rel & ~63u) + 63 - __builtin_clzll(w);
+                return res >= relBegin ? res+this->x0 : end;
+            }
+            if((rel & ~63u) <= relBegin){
+                return end;
+            }
+            rel = (rel & ~63u) - 1;
+        }
+    }
+    // Steps (x,y) by (dx,dy) until a pixel whose bit equals value, rows are walked a word at a time.
+    // Returns false if the walk leaves the mask first.
+    bool walk(uint32_t &x, uint32_t &y, int dx, int dy, bool value) const {
+        if(dy == 0){
+            uint32_t end = this->x0+this->width;
+            if(y-this->y0 >= this->height || x-this->x0 >= this->width){
+                return false;
+            }
+            uint32_t res;
+            if(dx > 0){
+                res = this->find(y,x+1,end,value);
+                if(res == end){
+                    return false;
+                }
+            }else{
+                res = this->rfind(y,this->x0,x,value);
+                if(res == x){
+                    return false;
+                }
+            }
+            x = res;
+            return true;
+        }
+        do{
+            x += dx;
+            y += dy;
+            if(x-this->x0 >= this->width || y-this->y0 >= this->height){
+                return false;
+            }
+        }while(this->test(x,y) != value);
+        return true;
+    }
+};
@@ -0,0 +1,142 @@
+#pragma once
+
+#include <cstdint>
+#include <cmath>
+#include <algorithm>
+#include <vector>
+
+#include "mask.h"
+#include "bounds.h"
+#include "thread_pool.h"
+#include "profiler.h"
+
+// Pad ellipse from the zeroth, first and second moments of the border and pad masks together. A
+// filled ellipse with semi-axes a and b has variances a^2/4 and b^2/4 along its axes, so the
+// eigenvalues of the covariance give the axes and its eigenvectors the orientation. The sums are
+// taken a mask word at a time with popcounts, in row bands like the analysis, and nothing follows
+// the pad's outline.
+namespace moments{
+    struct sums{
+        uint64_t n = 0;
+        uint64_t sx = 0, sy = 0;
+        uint64_t sxx = 0, syy = 0, sxy = 0;
+        void add(const sums &s){
+            this->n += s.n;
+            this->sx += s.sx;
+            this->sy += s.sy;
+            this->sxx += s.sxx;
+            this->syy += s.syy;
+            this->sxy += s.sxy;
+        }
+    };
+    struct ellipse{
+        // Centre in frame pixels
+        double cx, cy;
+        // Semi-axes, major first, and the angle of the major axis in radians
+        double a, b;
+        double angle;
+    };
+
+    // False for fewer than two pixels
+    bool fit(const sums &s, ellipse &res){
+        if(s.n < 2){
+            return false;
+        }
+        double n = s.n;
+        double cx = s.sx/n, cy = s.sy/n;
+        double xx = s.sxx/n - cx*cx, yy = s.syy/n - cy*cy, xy = s.sxy/n - cx*cy;
+        double mean = 0.5*(xx+yy), spread = std::sqrt(0.25*(xx-yy)*(xx-yy) + xy*xy);
+        // Pixel centres are at index + 0.5
+        res.cx = cx+0.5;
+        res.cy = cy+0.5;
+        res.a = 2.0*std::sqrt(mean+spread);
+        res.b = 2.0*std::sqrt(std::max(mean-spread,0.0));
+        res.angle = 0.5*std::atan2(2.0*xy,xx-yy);
+        return true;
+    }
+
+    // Bit i of a mask word is in slice k when bit k of i is set
+    constexpr uint64_t SLICES[6] = {
+        0xaaaaaaaaaaaaaaaaULL, 0xccccccccccccccccULL, 0xf0f0f0f0f0f0f0f0ULL,
+        0xff00ff00ff00ff00ULL, 0xffff0000ffff0000ULL, 0xffffffff00000000ULL
+    };
+    // Count, sum and sum of squares of the positions of the set bits of w. With i the sum of its
+    // bits i_k*2^k, i^2 is the sum of i_j*i_k*2^(j+k) over all pairs, so every term is a popcount
+    // of two slices together.
+    inline void word(uint64_t w, uint64_t &count, uint64_t &sum, uint64_t &squares){
+        count = __builtin_popcountll(w);
+        sum = 0;
+        squares = 0;
+        for(int k=0;k<6;++k){
+            uint64_t wk = w & SLICES[k];
+            uint64_t c = __builtin_popcountll(wk);
+            sum += c << k;
+            squares += c << 2*k;
+            for(int j=k+1;j<6;++j){
+                squares += (uint64_t)__builtin_popcountll(wk & SLICES[j]) << (j+k+1);
+            }
+        }
+    }
+
+    class Accumulator{
+    public:
+        ThreadPool *pool;
+        Accumulator(ThreadPool *pool = nullptr){
+            this->pool = pool;
+            this->bands.resize(RowBands::most(pool));
+        }
+        // Sums over the pixels of extent set in either mask. Both masks cover the same window,
+        // which extent lies in.
+        void run(const ColorMask &border, const ColorMask &pad, const bounds::box &extent, sums &res){
+            PROFILE_SCOPE(MOMENTS);
+            RowBands rows(this->pool,extent.max.y-extent.min.y+1);
+            rows.run([&](uint32_t i, uint32_t y0, uint32_t y1){
+                accumulateBand(border,pad,extent,extent.min.y+y0,extent.min.y+y1,this->bands[i]);
+            });
+            res = sums();
+            for(uint32_t i=0;i<rows.size();++i){
+                res.add(this->bands[i]);
+            }
+        }
+    private:
+        std::vector<sums> bands;
+
+        static void accumulateBand(const ColorMask &border, const ColorMask &pad, const bounds::box &extent, uint32_t y0, uint32_t y1, sums &res){
+            res = sums();
+            uint32_t left = extent.min.x-border.x0, right = extent.max.x-border.x0;
+            uint32_t first = left >> 6, last = right >> 6;
+            uint64_t firstBits = ~0ULL << (left & 63), lastBits = ~0ULL >> (63 - (right & 63));
+            // Sums of a full word, the inside of the pad is mostly these
+            constexpr uint64_t FULL_SUM = 63*64/2, FULL_SQUARES = 63*64*127/6;
+            for(uint32_t y=y0;y<y1;++y){
+                const uint64_t *b = border.row(y), *p = pad.row(y);
+                uint64_t count = 0, sum = 0, squares = 0;
+                for(uint32_t k=first;k<=last;++k){
+                    uint64_t w = (b[k] | p[k]) & (k == first ? firstBits : ~0ULL) & (k == last ? lastBits : ~0ULL);
+                    if(w == 0){
+                        continue;
+                    }
+                    uint64_t c, s, q;
+                    if(w == ~0ULL){
+                        c = 64;
+                        s = FULL_SUM;
+                        q = FULL_SQUARES;
+                    }else{
+                        word(w,c,s,q);
+                    }
+                    // Positions in the word are offset by the word's first x
+                    uint64_t base = border.x0 + 64*k;
+                    count += c;
+                    sum += s + base*c;
+                    squares += q + 2*base*s + base*base*c;
+                }
+                res.n += count;
+                res.sx += sum;
+                res.sy += (uint64_t)y*count;
+                res.sxx += squares;
+                res.syy += (uint64_t)y*y*count;
+                res.sxy += (uint64_t)y*sum;
+            }
+        }
+    };
+}
@@ -1,6 +1,11 @@
 #pragma once
 
 #include <cstdint>
+#include <vector>
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#endif
 
 namespace perlin{
     uint32_t hashA(uint32_t x) {
@@ -29,4 +34,49 @@ namespace perlin{
         float dx = x-xmin, dy = y-ymin;
         return lerp(lerp(c[0][0],c[1][0],dy),lerp(c[0][1],c[1][1],dy),dx);
     }
+    // out[i] = noise2d(x, yOffset + i/yScale) for i in [0,count), bit-identical to calling noise2d.
+    // x is fixed, so the corner hashes only change between lattice rows and each one is computed once.
+    void noise2dRow(float x, int yOffset, float yScale, uint32_t count, float *out){
+        if(count == 0){
+            return;
+        }
+        int xmin = x;
+        float dx = x-xmin;
+        // Truncation is monotonic, so the first and last sample bound the lattice rows used
+        int first = (int)(yOffset + 0/yScale);
+        int last = (int)(yOffset + (count-1)/yScale) + 1;
+        // Hashes of the two lattice columns either side of x
+        std::vector<float> left(last-first+1), right(last-first+1);
+        for(int j=first;j<=last;++j){
+            left[j-first] = hash(xmin,j);
+            right[j-first] = hash(xmin+1,j);
+        }
+        uint32_t i = 0;
+#if defined(__AVX2__)
+        // Same operations in the same order as the scalar path, only 8 samples at a time
+        const __m256 one = _mm256_set1_ps(1.0f), offset = _mm256_set1_ps((float)yOffset), scale = _mm256_set1_ps(yScale);
+        const __m256 vdx = _mm256_set1_ps(dx), vdx1 = _mm256_sub_ps(one,vdx);
+        const __m256i lane = _mm256_setr_epi32(0,1,2,3,4,5,6,7), base = _mm256_set1_epi32(first);
+        for(;i+8<=count;i+=8){
+            __m256 y = _mm256_add_ps(offset,_mm256_div_ps(_mm256_cvtepi32_ps(_mm256_add_epi32(_mm256_set1_epi32(i),lane)),scale));
+            __m256i ymin = _mm256_cvttps_epi32(y);
+            __m256 dy = _mm256_sub_ps(y,_mm256_cvtepi32_ps(ymin));
+            __m256 dy1 = _mm256_sub_ps(one,dy);
+            __m256i idx = _mm256_sub_epi32(ymin,base);
+            __m256i idx1 = _mm256_add_epi32(idx,_mm256_set1_epi32(1));
+            __m256 c00 = _mm256_i32gather_ps(left.data(),idx,4), c10 = _mm256_i32gather_ps(left.data(),idx1,4);
+            __m256 c01 = _mm256_i32gather_ps(right.data(),idx,4), c11 = _mm256_i32gather_ps(right.data(),idx1,4);
+            __m256 l = _mm256_add_ps(_mm256_mul_ps(c00,dy1),_mm256_mul_ps(c10,dy));
+            __m256 r = _mm256_add_ps(_mm256_mul_ps(c01,dy1),_mm256_mul_ps(c11,dy));
+            _mm256_storeu_ps(out+i,_mm256_add_ps(_mm256_mul_ps(l,vdx1),_mm256_mul_ps(r,vdx)));
+        }
+#endif
+        for(;i<count;++i){
+            float y = yOffset + i/yScale;
+            int ymin = y;
+            float dy = y-ymin;
+            int j = ymin-first;
+            out[i] = lerp(lerp(left[j],left[j+1],dy),lerp(right[j],right[j+1],dy),dx);
+        }
+    }
 };
\ No newline at end of file
@@ -0,0 +1,147 @@
+#pragma once
+
+#include <cstdint>
+#include <iostream>
+
+// Scoped timers and counters for the frame loop. Build with -DLANDINGPAD_PROFILE to enable them,
+// otherwise every macro expands to nothing.
+//
+//  PROFILE_SCOPE(DETECT);              time until the end of the enclosing scope
+//  PROFILE_COUNT(LINEAR_SEARCH_STEPS, n);  record a single value
+//  PROFILE_TALLY(TRACE_STEPS, steps);  counter recorded when it goes out of scope
+//  PROFILE_TICK(steps, 1);             add to a tally
+
+namespace profiler{
+    enum Probe : uint8_t{
+        // Timers, in nanoseconds
+        RENDER, READBACK, DETECT, ANALYSIS, PYRAMID, TRACK, LINEAR_SEARCH, X_DIR_OF_MAX, TRACE_BORDER, FIT, CORRELATE, MOMENTS, EDGES,
+        // Counters
+        LINEAR_SEARCH_STEPS, TRACE_STEPS,
+        PROBE_COUNT
+    };
+    const char *probeNames[PROBE_COUNT] = {
+        "render", "readback", "detect", "analysis", "pyramid", "track", "linearSearch", "xDirOfMax", "traceBorder", "fit", "correlate", "moments", "edges",
+        "linearSearch steps", "traceBorder steps"
+    };
+    constexpr Probe FIRST_COUNTER = LINEAR_SEARCH_STEPS;
+}
+
+#ifdef LANDINGPAD_PROFILE
+
+#include <atomic>
+#include <chrono>
+#include <mutex>
+#include <vector>
+#include <algorithm>
+
+namespace profiler{
+    // Last RING_SIZE records of one thread. Each record is one word, probe in the top byte, so the
+    // reporting thread can read it while the owner keeps writing.
+    constexpr uint32_t RING_SIZE = 4096;
+    struct Ring{
+        std::atomic<uint64_t> records[RING_SIZE];
+        std::atomic<uint64_t> head{0};
+        Ring();
+        ~Ring();
+        void push(Probe probe, uint64_t value){
+            uint64_t h = this->head.load(std::memory_order_relaxed);
+            this->records[h % RING_SIZE].store(((uint64_t)probe << 56) | (value & ((1ULL << 56)-1)),std::memory_order_relaxed);
+            this->head.store(h+1,std::memory_order_release);
+        }
+    };
+
+    std::mutex registryMutex;
+    std::vector<Ring*> registry;
+
+    Ring::Ring(){
+        for(std::atomic<uint64_t> &r : this->records){
+            r.store(0,std::memory_order_relaxed);
+        }
+        std::lock_guard<std::mutex> lock(registryMutex);
+        registry.push_back(this);
+    }
+    Ring::~Ring(){
+        std::lock_guard<std::mutex> lock(registryMutex);
+        registry.erase(std::find(registry.begin(),registry.end(),this));
+    }
+
+    thread_local Ring ring;
+
+    uint64_t now(){
+        return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+    }
+    void record(Probe probe, uint64_t value){
+        ring.push(probe,value);
+    }
+
+    class Scope{
+    public:
+        Scope(Probe probe) : probe(probe), start(now()){}
+        ~Scope(){
+            record(this->probe,now()-this->start);
+        }
+    private:
+        Probe probe;
+        uint64_t start;
+    };
+    class Tally{
+    public:
+        uint64_t value = 0;
+        Tally(Probe probe) : probe(probe){}
+        ~Tally(){
+            record(this->probe,this->value);
+        }
+    private:
+        Probe probe;
+    };
+
+    // Percentiles over everything still held in the rings of all threads
+    void report(std::ostream &out){
+        std::vector<uint64_t> values[PROBE_COUNT];
+        {
+            std::lock_guard<std::mutex> lock(registryMutex);
+            for(Ring *r : registry){
+                uint64_t head = r->head.load(std::memory_order_acquire);
+                for(uint64_t i=head-std::min<uint64_t>(head,RING_SIZE);i<head;++i){
+                    uint64_t rec = r->records[i % RING_SIZE].load(std::memory_order_relaxed);
+                    values[rec >> 56].push_back(rec & ((1ULL << 56)-1));
+                }
+            }
+        }
+        out << "probe (us or count) count\tp50\tp90\tp99\tmax" << std::endl;
+        for(int p=0;p<PROBE_COUNT;++p){
+            std::vector<uint64_t> &v = values[p];
+            if(v.empty()){
+                continue;
+            }
+            std::sort(v.begin(),v.end());
+            // Timers are shown in microseconds
+            double scale = p < FIRST_COUNTER ? 1e-3 : 1.0;
+            auto at = [&](double q){return v[std::min(v.size()-1,(size_t)(q*v.size()))]*scale;};
+            out << probeNames[p] << std::string(std::max(1,20-(int)std::string(probeNames[p]).size()),' ')
+                << v.size() << "\t" << at(0.5) << "\t" << at(0.9) << "\t" << at(0.99) << "\t" << v.back()*scale << std::endl;
+        }
+    }
+}
+
+#define PROFILE_CONCAT_(a,b) a##b
+#define PROFILE_CONCAT(a,b) PROFILE_CONCAT_(a,b)
+#define PROFILE_SCOPE(probe) profiler::Scope PROFILE_CONCAT(profileScope,__LINE__)(profiler::probe)
+#define PROFILE_COUNT(probe, n) profiler::record(profiler::probe,(n))
+#define PROFILE_TALLY(probe, name) profiler::Tally name(profiler::probe)
+#define PROFILE_TICK(name, n) name.value += (n)
+
+#else
+
+namespace profiler{
+    void report(std::ostream &out){
+        out << "Profiling is disabled, build with -DLANDINGPAD_PROFILE" << std::endl;
+    }
+}
+
+#define PROFILE_SCOPE(probe)
+#define PROFILE_COUNT(probe, n)
+#define PROFILE_TALLY(probe, name)
+#define PROFILE_TICK(name, n)
+
+#endif
@@ -0,0 +1,218 @@
+#pragma once
+
+#include <cstdint>
+#include <algorithm>
+#include <vector>
+
+#if defined(__AVX2__) || defined(__SSE2__)
+#include <immintrin.h>
+#endif
+
+#include "image.h"
+#include "simd.h"
+#include "bounds.h"
+#include "analysis.h"
+#include "thread_pool.h"
+#include "arena.h"
+
+// Frame downsampled by 2 per level. Level 0 is the frame itself, level n pixel (x,y) stands for frame
+// pixels [x<<n,(x+1)<<n) x [y<<n,(y+1)<<n) and is the average of the 2x2 frame pixels at the centre of
+// that block. Every level is reduced straight from the frame and reads only 2 of each 1<<n rows, so the
+// coarse levels cost a fraction of a full frame pass.
+namespace pyramid{
+    // Rows [y0,y1) of level l from the frame. Both averaging steps round up like pavgb, so every
+    // instruction set produces the same pixels.
+    void reduce(const rgba *src, uint32_t srcStride, rgba *dst, uint32_t dstStride, uint32_t width, uint32_t l, uint32_t y0, uint32_t y1){
+        uint32_t half = (1u << l)/2;
+        for(uint32_t y=y0;y<y1;++y){
+            const rgba *r0 = src + ((y << l) + half-1)*srcStride + half-1, *r1 = r0 + srcStride;
+            rgba *out = dst + y*dstStride;
+            uint32_t x = 0;
+#if defined(__AVX2__)
+            if(l == 1){
+                for(;x+8<=width;x+=8){
+                    __m256i a = _mm256_avg_epu8(_mm256_loadu_si256((const __m256i*)(r0+2*x)),_mm256_loadu_si256((const __m256i*)(r1+2*x)));
+                    __m256i b = _mm256_avg_epu8(_mm256_loadu_si256((const __m256i*)(r0+2*x+8)),_mm256_loadu_si256((const __m256i*)(r1+2*x+8)));
+                    // Even and odd pixels of a and b, per 128 bit lane, then lanes back in order
+                    __m256 even = _mm256_shuffle_ps(_mm256_castsi256_ps(a),_mm256_castsi256_ps(b),0x88);
+                    __m256 odd = _mm256_shuffle_ps(_mm256_castsi256_ps(a),_mm256_castsi256_ps(b),0xDD);
+                    __m256i res = _mm256_avg_epu8(_mm256_castps_si256(even),_mm256_castps_si256(odd));
+                    _mm256_storeu_si256((__m256i*)(out+x),_mm256_permute4x64_epi64(res,0xD8));
+                }
+            }else if(l == 2){
+                // r0 and r1 already start at the second pixel of each block of 4
+                const __m256i order = _mm256_setr_epi32(0,4,2,6,0,0,0,0);
+                for(;x+4<=width && 4*x+16<=width << 2;x+=4){
+                    __m256i a = _mm256_avg_epu8(_mm256_loadu_si256((const __m256i*)(r0+4*x-1)),_mm256_loadu_si256((const __m256i*)(r1+4*x-1)));
+                    __m256i b = _mm256_avg_epu8(_mm256_loadu_si256((const __m256i*)(r0+4*x+7)),_mm256_loadu_si256((const __m256i*)(r1+4*x+7)));
+                    __m256 left = _mm256_shuffle_ps(_mm256_castsi256_ps(a),_mm256_castsi256_ps(b),0x55);
+                    __m256 right = _mm256_shuffle_ps(_mm256_castsi256_ps(a),_mm256_castsi256_ps(b),0xAA);
+                    __m256i res = _mm256_permutevar8x32_epi32(_mm256_avg_epu8(_mm256_castps_si256(left),_mm256_castps_si256(right)),order);
+                    _mm_storeu_si128((__m128i*)(out+x),_mm256_castsi256_si128(res));
+                }
+            }
+#endif
+            for(;x<width;++x){
+                const uint8_t *p[4] = {(const uint8_t*)(r0+(x << l)),(const uint8_t*)(r0+(x << l)+1),(const uint8_t*)(r1+(x << l)),(const uint8_t*)(r1+(x << l)+1)};
+                uint8_t *o = (uint8_t*)(out+x);
+                for(int c=0;c<4;++c){
+                    uint8_t left = (p[0][c]+p[2][c]+1)>>1, right = (p[1][c]+p[3][c]+1)>>1;
+                    o[c] = (left+right+1)>>1;
+                }
+            }
+        }
+    }
+
+    class Pyramid{
+    public:
+        // Takes a new frame. Levels are reduced into arena the first time they are prepared for it
+        // and stay valid until the arena is reset.
+        void build(const rgba *pixels, uint32_t width, uint32_t height, uint32_t stride, uint32_t levels, Arena &arena, ThreadPool *pool = nullptr){
+            this->pool = pool;
+            this->arena = &arena;
+            this->widths.resize(levels+1);
+            this->heights.resize(levels+1);
+            this->strides.resize(levels+1);
+            this->pixels.assign(levels+1,nullptr);
+            this->widths[0] = width;
+            this->heights[0] = height;
+            this->strides[0] = stride;
+            this->pixels[0] = pixels;
+            for(uint32_t l=1;l<=levels;++l){
+                this->widths[l] = width >> l;
+                this->heights[l] = height >> l;
+                this->strides[l] = width >> l;
+            }
+        }
+        void prepare(uint32_t l){
+            if(this->pixels[l]){
+                return;
+            }
+            uint32_t w = this->widths[l], h = this->heights[l];
+            rgba *dst = this->arena->allocate<rgba>((size_t)w*h);
+            RowBands(this->pool,h).run([&](uint32_t, uint32_t y0, uint32_t y1){
+                reduce(this->pixels[0],this->strides[0],dst,w,w,l,y0,y1);
+            });
+            this->pixels[l] = dst;
+        }
+        // Level l of the current frame, prepare(l) must have been called
+        const rgba *level(uint32_t l) const {
+            return this->pixels[l];
+        }
+        uint32_t width(uint32_t l) const {
+            return this->widths[l];
+        }
+        uint32_t height(uint32_t l) const {
+            return this->heights[l];
+        }
+        uint32_t stride(uint32_t l) const {
+            return this->strides[l];
+        }
+    private:
+        ThreadPool *pool = nullptr;
+        Arena *arena = nullptr;
+        std::vector<uint32_t> widths, heights, strides;
+        std::vector<const rgba*> pixels;
+    };
+
+    // Extents of everything inside either range on level l, false if there is nothing
+    bool find(const Pyramid &pyr, uint32_t l, const simd::ColorRange &a, const simd::ColorRange &b, bounds::box &res){
+        bounds::box ea, eb;
+        bool fa = bounds::find(pyr.level(l),pyr.width(l),pyr.height(l),pyr.stride(l),a,ea);
+        bool fb = bounds::find(pyr.level(l),pyr.width(l),pyr.height(l),pyr.stride(l),b,eb);
+        if(!fa && !fb){
+            return false;
+        }
+        if(fa && fb){
+            res.min = {std::min(ea.min.x,eb.min.x),std::min(ea.min.y,eb.min.y)};
+            res.max = {std::max(ea.max.x,eb.max.x),std::max(ea.max.y,eb.max.y)};
+        }else{
+            res = fa ? ea : eb;
+        }
+        return true;
+    }
+    // Level l extents scaled to the frame, grown by margin frame pixels and clamped to it
+    bounds::box frame(const Pyramid &pyr, uint32_t l, const bounds::box &extent, uint32_t margin){
+        int minX = (int)(extent.min.x << l) - (int)margin, minY = (int)(extent.min.y << l) - (int)margin;
+        int maxX = (int)(((extent.max.x+1) << l) - 1 + margin), maxY = (int)(((extent.max.y+1) << l) - 1 + margin);
+        return {
+            {(uint32_t)std::max(minX,0),(uint32_t)std::max(minY,0)},
+            {(uint32_t)std::min(maxX,(int)pyr.width(0)-1),(uint32_t)std::min(maxY,(int)pyr.height(0)-1)}
+        };
+    }
+
+    // Outer border ends of every frame row in window, like analysis::Analyzer::run without masks, but
+    // each row is only searched near the outer edge of the pad on level l. The outer edge of pad and
+    // border together is the outer edge of the border, and it survives the averaging far better than
+    // the thin border does on its own. Scratch comes from arena.
+    void refine(const Pyramid &pyr, uint32_t l, const bounds::box &window, const simd::ColorRange &borderRange, const simd::ColorRange &padRange, Arena &arena, analysis::result &res){
+        res.found = false;
+        res.borderCount = 0;
+        res.padCount = 0;
+        res.samples.clear();
+        uint32_t scale = 1u << l;
+        uint32_t cy0 = window.min.y >> l, cy1 = std::min(pyr.height(l),(window.max.y >> l)+1);
+        uint32_t cBegin = window.min.x >> l, cEnd = std::min(pyr.width(l),(window.max.x >> l)+1);
+        // First and last coarse pixel of each coarse row, first > last if the row is empty
+        uint32_t *edges = arena.allocate<uint32_t>(2*(cy1-cy0));
+        for(uint32_t cy=cy0;cy<cy1;++cy){
+            const rgba *row = pyr.level(l) + cy*pyr.stride(l);
+            uint32_t first = std::min(simd::firstMatch(row,cBegin,cEnd,borderRange),simd::firstMatch(row,cBegin,cEnd,padRange));
+            uint32_t last = 0;
+            if(first < cEnd){
+                uint32_t lb = simd::lastMatch(row,first,cEnd,borderRange), lp = simd::lastMatch(row,first,cEnd,padRange);
+                last = std::max(lb == cEnd ? first : lb,lp == cEnd ? first : lp);
+            }
+            edges[2*(cy-cy0)] = first;
+            edges[2*(cy-cy0)+1] = last;
+        }
+        const rgba *pixels = pyr.level(0);
+        uint32_t stride = pyr.stride(0);
+        uint32_t begin = window.min.x, end = window.max.x+1;
+        for(uint32_t y=window.min.y;y<=window.max.y;++y){
+            // Bands around the edges of the neighbouring coarse rows
+            uint32_t leftLo = cEnd, leftHi = 0, rightLo = cEnd, rightHi = 0;
+            int cy = y >> l;
+            for(int c=std::max(cy-2,(int)cy0);c<=std::min(cy+2,(int)cy1-1);++c){
+                uint32_t first = edges[2*(c-cy0)], last = edges[2*(c-cy0)+1];
+                if(first >= cEnd){
+                    continue;
+                }
+                leftLo = std::min(leftLo,first);
+                leftHi = std::max(leftHi,first);
+                rightLo = std::min(rightLo,last);
+                rightHi = std::max(rightHi,last);
+            }
+            if(leftLo >= cEnd){
+                continue;
+            }
+            uint32_t lo = std::max(begin,(leftLo << l) - std::min(leftLo << l,scale)), hi = std::min(end,((leftHi+2) << l));
+            const rgba *row = pixels+y*stride;
+            uint32_t first = simd::firstMatch(row,lo,hi,borderRange);
+            if(first == lo && lo > begin){
+                first = simd::firstMatch(row,begin,hi,borderRange);
+            }
+            if(first >= hi){
+                continue;
+            }
+            lo = std::max(first,(rightLo << l) - std::min(rightLo << l,scale));
+            hi = std::min(end,(rightHi+2) << l);
+            uint32_t last = simd::lastMatch(row,lo,hi,borderRange);
+            if(last == hi-1 && hi < end){
+                last = simd::lastMatch(row,lo,end,borderRange);
+            }
+            if(last >= end || last == hi){
+                last = simd::lastMatch(row,first,end,borderRange);
+            }
+            res.samples.push_back({(double)first,y+0.5});
+            res.samples.push_back({last+1.0,y+0.5});
+            if(!res.found){
+                res.extent = {{first,y},{last,y}};
+                res.found = true;
+            }else{
+                res.extent.min.x = std::min(res.extent.min.x,first);
+                res.extent.max = {std::max(res.extent.max.x,last),y};
+            }
+        }
+    }
+}
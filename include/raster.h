@@ -0,0 +1,257 @@
+#pragma once
+
+#include <cstdint>
+#include <cstring>
+#include <cmath>
+#include <algorithm>
+#include <vector>
+
+#include "glm.hpp"
+
+#include "image.h"
+#include "thread_pool.h"
+#include "mapped_file.h"
+
+namespace raster{
+    // Same layout as the vertex buffer uploaded to OpenGL
+    struct Vertex{
+        float pos[3];
+        uint16_t texCoords[2];
+    };
+
+    // CPU side RGBA texture with the same fields the filters write through
+    class Texture{
+    public:
+        int width, height;
+        uint8_t *buffer;
+        uint32_t *buffer32;
+        Texture(int width, int height){
+            this->width = width;
+            this->height = height;
+            this->buffer32 = new uint32_t[width*height]();
+            this->buffer = (uint8_t*)this->buffer32;
+        }
+        // Texels read straight out of a mapped file starting at offset, kept mapped for the texture's lifetime
+        Texture(MappedFile &&file, size_t offset, int width, int height) : mapping(std::move(file)){
+            this->width = width;
+            this->height = height;
+            this->buffer = this->mapping.data()+offset;
+            this->buffer32 = (uint32_t*)this->buffer;
+        }
+        Texture(const Texture&) = delete;
+        Texture &operator=(const Texture&) = delete;
+        ~Texture(){
+            if(!this->mapping.data()){
+                delete[] this->buffer32;
+            }
+        }
+        rgba texel(int x, int y) const {
+            x = std::min(std::max(x,0),this->width-1);
+            y = std::min(std::max(y,0),this->height-1);
+            return ((const rgba*)this->buffer32)[x + y*this->width];
+        }
+        // Bilinear filtering with clamp to edge, matching GL_LINEAR
+        glm::vec4 sample(float u, float v) const {
+            float x = u*this->width - 0.5f, y = v*this->height - 0.5f;
+            int x0 = (int)std::floor(x), y0 = (int)std::floor(y);
+            // 8 bit weights, the same precision GPUs filter with
+            uint32_t fx = (uint32_t)((x-x0)*256.0f), fy = (uint32_t)((y-y0)*256.0f);
+            rgba c[4] = {this->texel(x0,y0),this->texel(x0+1,y0),this->texel(x0,y0+1),this->texel(x0+1,y0+1)};
+            uint32_t w[4] = {(256-fx)*(256-fy),fx*(256-fy),(256-fx)*fy,fx*fy};
+            uint32_t r = 0, g = 0, b = 0, a = 0;
+            for(int i=0;i<4;++i){
+                r += w[i]*c[i].r;
+                g += w[i]*c[i].g;
+                b += w[i]*c[i].b;
+                a += w[i]*c[i].a;
+            }
+            return glm::vec4(r,g,b,a)*(1.0f/(255.0f*65536.0f));
+        }
+    private:
+        MappedFile mapping;
+    };
+
+    // Software version of the two render passes in main: the textured quad is drawn into a cleared
+    // RGBA8 target with alpha blending, which is then blended over the clear colour of the window.
+    // Rows are written bottom up like glReadPixels. Tiles are spread over the pool when there is one.
+    class Rasterizer{
+    public:
+        int width, height;
+        static constexpr int TILE_SIZE = 32;
+        rgba clearColor = {0,128,0,255};
+        ThreadPool *pool;
+        Rasterizer(int width, int height, ThreadPool *pool = nullptr){
+            this->width = width;
+            this->height = height;
+            this->pool = pool;
+        }
+        void render(const Vertex *vertices, const uint32_t *indices, int indexCount, const glm::mat4 &modelMat, const glm::mat4 &vp, const Texture &texture, rgba *target){
+            glm::mat4 mvp = vp*modelMat;
+            this->triangles.clear();
+            for(int i=0;i+2<indexCount;i+=3){
+                ClipVertex tri[3];
+                for(int j=0;j<3;++j){
+                    const Vertex &v = vertices[indices[i+j]];
+                    tri[j].pos = mvp*glm::vec4(v.pos[0],v.pos[1],v.pos[2],1.0f);
+                    tri[j].uv = glm::vec2(v.texCoords[0],v.texCoords[1])/65535.0f;
+                }
+                this->clipAndAdd(tri);
+            }
+
+            int tilesX = (this->width+TILE_SIZE-1)/TILE_SIZE;
+            int tilesY = (this->height+TILE_SIZE-1)/TILE_SIZE;
+            int tileCount = tilesX*tilesY;
+            auto tile = [&](int t){
+                this->renderTile((t%tilesX)*TILE_SIZE,(t/tilesX)*TILE_SIZE,texture,target);
+            };
+            if(this->pool){
+                this->pool->parallelFor(tileCount,tile);
+            }else{
+                for(int t=0;t<tileCount;++t){
+                    tile(t);
+                }
+            }
+        }
+    private:
+        struct ClipVertex{
+            glm::vec4 pos;
+            glm::vec2 uv;
+        };
+        struct Triangle{
+            // Screen position, 1/w and uv/w for each corner
+            float x[3], y[3], iw[3], uw[3], vw[3];
+            float invArea;
+            bool owns[3];
+            int minX, minY, maxX, maxY;
+        };
+        std::vector<Triangle> triangles;
+
+        // Clips against the near plane and fans the result into screen space triangles
+        void clipAndAdd(const ClipVertex tri[3]){
+            ClipVertex poly[4];
+            int count = 0;
+            for(int i=0;i<3;++i){
+                const ClipVertex &a = tri[i], &b = tri[(i+1)%3];
+                float da = a.pos.z + a.pos.w, db = b.pos.z + b.pos.w;
+                if(da >= 0){
+                    poly[count++] = a;
+                }
+                if((da >= 0) != (db >= 0)){
+                    float t = da/(da-db);
+                    poly[count++] = {a.pos + t*(b.pos-a.pos),a.uv + t*(b.uv-a.uv)};
+                }
+            }
+            for(int i=1;i+1<count;++i){
+                this->addTriangle(poly[0],poly[i],poly[i+1]);
+            }
+        }
+        void addTriangle(const ClipVertex &a, const ClipVertex &b, const ClipVertex &c){
+            const ClipVertex *v[3] = {&a,&b,&c};
+            Triangle tri;
+            for(int i=0;i<3;++i){
+                float iw = 1.0f/v[i]->pos.w;
+                tri.x[i] = (v[i]->pos.x*iw*0.5f + 0.5f)*this->width;
+                tri.y[i] = (v[i]->pos.y*iw*0.5f + 0.5f)*this->height;
+                tri.iw[i] = iw;
+                tri.uw[i] = v[i]->uv.x*iw;
+                tri.vw[i] = v[i]->uv.y*iw;
+            }
+            float area = (tri.x[1]-tri.x[0])*(tri.y[2]-tri.y[0]) - (tri.y[1]-tri.y[0])*(tri.x[2]-tri.x[0]);
+            if(area == 0.0f || !std::isfinite(area)){
+                return;
+            }
+            if(area < 0){
+                std::swap(tri.x[1],tri.x[2]);
+                std::swap(tri.y[1],tri.y[2]);
+                std::swap(tri.iw[1],tri.iw[2]);
+                std::swap(tri.uw[1],tri.uw[2]);
+                std::swap(tri.vw[1],tri.vw[2]);
+                area = -area;
+            }
+            tri.invArea = 1.0f/area;
+            // Pixels exactly on an edge shared by two triangles belong to only one of them
+            for(int i=0;i<3;++i){
+                int a = (i+1)%3, b = (i+2)%3;
+                float dx = tri.x[b]-tri.x[a], dy = tri.y[b]-tri.y[a];
+                tri.owns[i] = dy < 0 || (dy == 0 && dx > 0);
+            }
+            tri.minX = std::max(0,(int)std::floor(std::min({tri.x[0],tri.x[1],tri.x[2]})));
+            tri.minY = std::max(0,(int)std::floor(std::min({tri.y[0],tri.y[1],tri.y[2]})));
+            tri.maxX = std::min(this->width-1,(int)std::ceil(std::max({tri.x[0],tri.x[1],tri.x[2]})));
+            tri.maxY = std::min(this->height-1,(int)std::ceil(std::max({tri.y[0],tri.y[1],tri.y[2]})));
+            if(tri.minX <= tri.maxX && tri.minY <= tri.maxY){
+                this->triangles.push_back(tri);
+            }
+        }
+        static uint8_t unorm(float f){
+            return (uint8_t)(std::min(std::max(f,0.0f),1.0f)*255.0f + 0.5f);
+        }
+        void renderTile(int x0, int y0, const Texture &texture, rgba *target){
+            int x1 = std::min(x0+TILE_SIZE,this->width);
+            int y1 = std::min(y0+TILE_SIZE,this->height);
+            // First pass target, cleared to transparent black
+            glm::vec4 fbo[TILE_SIZE*TILE_SIZE];
+            bool covered[TILE_SIZE*TILE_SIZE];
+            int tw = x1-x0;
+            std::fill(covered,covered+tw*(y1-y0),false);
+            for(const Triangle &tri : this->triangles){
+                if(tri.maxX < x0 || tri.minX >= x1 || tri.maxY < y0 || tri.minY >= y1){
+                    continue;
+                }
+                int bx0 = std::max(x0,tri.minX), bx1 = std::min(x1-1,tri.maxX);
+                int by0 = std::max(y0,tri.minY), by1 = std::min(y1-1,tri.maxY);
+                // Edge functions, stepped along each row
+                float step[3], e0[3];
+                for(int i=0;i<3;++i){
+                    int a = (i+1)%3, b = (i+2)%3;
+                    step[i] = -(tri.y[b]-tri.y[a]);
+                    e0[i] = (tri.x[b]-tri.x[a])*(by0+0.5f-tri.y[a]) - (tri.y[b]-tri.y[a])*(bx0+0.5f-tri.x[a]);
+                }
+                for(int y=by0;y<=by1;++y){
+                    float rowStart[3];
+                    for(int i=0;i<3;++i){
+                        int a = (i+1)%3, b = (i+2)%3;
+                        rowStart[i] = e0[i] + (tri.x[b]-tri.x[a])*(y-by0);
+                    }
+                    for(int x=bx0;x<=bx1;++x){
+                        float e[3];
+                        bool inside = true;
+                        for(int i=0;i<3;++i){
+                            e[i] = rowStart[i] + step[i]*(x-bx0);
+                            inside = inside && (e[i] > 0 || (e[i] == 0 && tri.owns[i]));
+                        }
+                        if(!inside){
+                            continue;
+                        }
+                        float l0 = e[0]*tri.invArea, l1 = e[1]*tri.invArea, l2 = e[2]*tri.invArea;
+                        float iw = l0*tri.iw[0] + l1*tri.iw[1] + l2*tri.iw[2];
+                        float u = (l0*tri.uw[0] + l1*tri.uw[1] + l2*tri.uw[2])/iw;
+                        float v = (l0*tri.vw[0] + l1*tri.vw[1] + l2*tri.vw[2])/iw;
+                        glm::vec4 src = texture.sample(u,v);
+                        int i = (x-x0) + (y-y0)*tw;
+                        if(!covered[i]){
+                            fbo[i] = glm::vec4(0.0f);
+                            covered[i] = true;
+                        }
+                        fbo[i] = src*src.a + fbo[i]*(1.0f-src.a);
+                    }
+                }
+            }
+            // Second pass, the RGBA8 first pass target blended over the clear colour
+            glm::vec4 clear = glm::vec4(this->clearColor.r,this->clearColor.g,this->clearColor.b,this->clearColor.a)/255.0f;
+            for(int y=y0;y<y1;++y){
+                for(int x=x0;x<x1;++x){
+                    int i = (x-x0) + (y-y0)*tw;
+                    if(!covered[i]){
+                        target[x + y*this->width] = this->clearColor;
+                        continue;
+                    }
+                    const glm::vec4 &f = fbo[i];
+                    glm::vec4 src = glm::vec4(unorm(f.r),unorm(f.g),unorm(f.b),unorm(f.a))/255.0f;
+                    glm::vec4 res = src*src.a + clear*(1.0f-src.a);
+                    target[x + y*this->width] = {unorm(res.r),unorm(res.g),unorm(res.b),unorm(res.a)};
+                }
+            }
+        }
+    };
+}
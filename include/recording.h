@@ -0,0 +1,160 @@
+#pragma once
+
+#include <cstdint>
+#include <cstring>
+#include <chrono>
+#include <vector>
+#include <fstream>
+#include <filesystem>
+
+#include "image.h"
+#include "mapped_file.h"
+#include "detector.h"
+#include "slot_writer.h"
+
+// Readback frames with the pose they were rendered from and what the detector made of them, so a
+// flight can be run again later without a window.
+//
+// File layout, every block a multiple of 64 bytes so pixels stay aligned in the mapping:
+//   file header: "LPRC", version, header size
+//   per frame:   frame header, then width*height pixels padded to 64 bytes
+// Frames are only ever appended. A reader walks the frame headers to index the file and ignores a
+// last frame cut short by a crash.
+namespace recording{
+    // 2: BORDER accuracy became 3, with MOMENTS at 2
+    constexpr uint32_t VERSION = 2;
+    constexpr uint32_t FILE_HEADER_SIZE = 64;
+    constexpr uint32_t FRAME_HEADER_SIZE = 128;
+
+    struct FileHeader{
+        char magic[4];
+        uint32_t version;
+        uint32_t headerSize;
+    };
+    struct FrameHeader{
+        char magic[4];
+        uint32_t headerSize;
+        // The frame loop's number, the same as in telemetry. Dropped frames leave gaps.
+        uint64_t frame;
+        // Nanoseconds since recording started
+        uint64_t timestamp;
+        uint32_t width, height;
+        // Camera position and the mouse angles it was looking along
+        float pos[3];
+        float yaw, pitch;
+        int32_t accuracy;
+        double calculated;
+        double actual;
+        // Bytes from the start of this header to the next one
+        uint64_t size;
+    };
+    static_assert(sizeof(FileHeader) <= FILE_HEADER_SIZE);
+    static_assert(sizeof(FrameHeader) <= FRAME_HEADER_SIZE);
+
+    uint64_t frameSize(uint32_t width, uint32_t height){
+        return FRAME_HEADER_SIZE + ((4ULL*width*height + 63) & ~63ULL);
+    }
+
+    // Copies frames into the slots of a SlotWriter, which appends them to the file on its thread
+    class Recorder{
+    public:
+        Recorder(const std::filesystem::path &path, uint32_t width, uint32_t height, uint32_t slots = 4)
+            : out(path,std::ios::binary), width(width), height(height), start(std::chrono::steady_clock::now()),
+            queue(slots,[this](Slot &slot){this->out.write((const char*)slot.block.data(),slot.block.size());}){
+            uint8_t block[FILE_HEADER_SIZE] = {};
+            FileHeader header = {{'L','P','R','C'},VERSION,FILE_HEADER_SIZE};
+            memcpy(block,&header,sizeof(header));
+            this->out.write((const char*)block,FILE_HEADER_SIZE);
+            this->opened = this->out.good();
+            for(uint32_t i=0;i<slots;++i){
+                this->queue[i].block.resize(frameSize(width,height));
+            }
+        }
+        Recorder(const Recorder&) = delete;
+        Recorder &operator=(const Recorder&) = delete;
+        // False if the file could not be created
+        bool good() const {
+            return this->opened;
+        }
+        // False if the frame was dropped
+        bool push(uint64_t frame, const rgba *pixels, uint32_t stride, const float pos[3], float yaw, float pitch, const detector::Detection &detection, double actual){
+            Slot *slot = this->queue.take();
+            if(!slot){
+                return false;
+            }
+            std::vector<uint8_t> &block = slot->block;
+            FrameHeader header = {};
+            memcpy(header.magic,"LPFR",4);
+            header.headerSize = FRAME_HEADER_SIZE;
+            header.frame = frame;
+            header.timestamp = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now()-this->start).count();
+            header.width = this->width;
+            header.height = this->height;
+            memcpy(header.pos,pos,sizeof(header.pos));
+            header.yaw = yaw;
+            header.pitch = pitch;
+            header.accuracy = detection.accuracy;
+            header.calculated = detection.calculatedDistance;
+            header.actual = actual;
+            header.size = block.size();
+            memcpy(block.data(),&header,sizeof(header));
+            for(uint32_t y=0;y<this->height;++y){
+                memcpy(block.data()+FRAME_HEADER_SIZE+4*y*this->width,pixels+y*stride,4*this->width);
+            }
+            this->queue.push(slot);
+            return true;
+        }
+        uint64_t dropped(){
+            return this->queue.dropped();
+        }
+    private:
+        struct Slot{
+            std::vector<uint8_t> block;
+        };
+        std::ofstream out;
+        bool opened;
+        uint32_t width, height;
+        std::chrono::steady_clock::time_point start;
+        SlotWriter<Slot> queue;
+    };
+
+    // A recording mapped into memory. Frames point straight into the mapping.
+    class Recording{
+    public:
+        // False if the file cannot be mapped or is not a recording
+        bool open(const std::filesystem::path &path){
+            this->offsets.clear();
+            if(!this->file.open(path) || this->file.size() < FILE_HEADER_SIZE){
+                return false;
+            }
+            const FileHeader &header = *(const FileHeader*)this->file.data();
+            if(memcmp(header.magic,"LPRC",4) != 0 || header.version != VERSION){
+                return false;
+            }
+            uint64_t offset = header.headerSize;
+            while(offset + FRAME_HEADER_SIZE <= this->file.size()){
+                const FrameHeader &frame = *(const FrameHeader*)(this->file.data()+offset);
+                if(memcmp(frame.magic,"LPFR",4) != 0 || frame.size != frameSize(frame.width,frame.height)
+                    || offset + frame.size > this->file.size()){
+                    break;
+                }
+                this->offsets.push_back(offset);
+                offset += frame.size;
+            }
+            return true;
+        }
+        size_t size() const {
+            return this->offsets.size();
+        }
+        const FrameHeader &header(size_t i) const {
+            return *(const FrameHeader*)(this->file.data()+this->offsets[i]);
+        }
+        // Rows are header(i).width pixels apart
+        const rgba *pixels(size_t i) const {
+            return (const rgba*)(this->file.data()+this->offsets[i]+FRAME_HEADER_SIZE);
+        }
+    private:
+        MappedFile file;
+        std::vector<uint64_t> offsets;
+    };
+}
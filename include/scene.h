@@ -0,0 +1,60 @@
+#pragma once
+
+#include <cstdint>
+#include <filesystem>
+
+#include "glm.hpp"
+#include "gtc/matrix_transform.hpp"
+
+#include "filters/circle.h"
+#include "filters/noise.h"
+
+#include "image.h"
+#include "raster.h"
+#include "thread_pool.h"
+#include "mapped_file.h"
+#include "texture_cache.h"
+
+constexpr float RADIUS = 1.0f;
+constexpr rgba PAD_COLOR = rgba{0,10,150,255};
+constexpr rgba BORDER_COLOR = rgba{0,0,0,255};
+constexpr int TOLERANCE = 55;
+constexpr float FOV = 3.1415926f*0.5f;
+constexpr rgba PAD_STROKE = rgba{0,0,0,255};
+constexpr uint32_t PAD_STROKE_WEIGHT = 475;
+constexpr rgba PAD_BACKGROUND = rgba{0,0,0,0};
+constexpr rgba PAD_NOISE = rgba{25,25,25,0};
+// Bump whenever padTexture's output changes so cached copies are regenerated
+constexpr uint32_t PAD_TEXTURE_VERSION = 1;
+
+// The landing pad shared by the OpenGL and software renderers
+namespace scene{
+    raster::Vertex quad[4] = {
+        {{-RADIUS,-RADIUS,0.0f},       {0,0}},
+        {{RADIUS,RADIUS,0.0f},   {65535,65535}},
+        {{RADIUS,-RADIUS,0.0f},     {65535,0}},
+        {{-RADIUS,RADIUS,0.0f},     {0,65535}}
+    };
+    uint32_t quadIndices[6] = {
+        2,1,0,
+        0,1,3
+    };
+    glm::mat4 model(){
+        return glm::rotate(glm::mat4(1.0f),1.57079633f,glm::vec3(1,0,0));
+    }
+    template<typename Image_t>
+    void padTexture(Image_t &image, ThreadPool *pool = nullptr){
+        filter::circle(image, PAD_COLOR, PAD_STROKE, PAD_STROKE_WEIGHT, true, PAD_BACKGROUND, pool);
+        filter::noise(image, PAD_NOISE, pool);
+    }
+    texcache::Key padKey(int width, int height){
+        return {PAD_TEXTURE_VERSION,width,height,{PAD_COLOR,PAD_STROKE,PAD_STROKE_WEIGHT,PAD_BACKGROUND,PAD_NOISE}};
+    }
+    // Maps the pad texture from the cache in dir, generating it on first use. False if the cache is
+    // unusable, padTexture then has to be run in memory.
+    bool cachedPadTexture(int width, int height, const std::filesystem::path &dir, MappedFile &file, ThreadPool *pool = nullptr){
+        return texcache::load(padKey(width,height),dir,file,[&](raster::Texture &texture){
+            padTexture(texture,pool);
+        });
+    }
+}
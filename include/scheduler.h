@@ -0,0 +1,127 @@
+#pragma once
+
+#include <cstdint>
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Runs small integer tasks on a fixed set of workers. Every worker has its own queue and takes the
+// newest task from it; a worker whose queue is empty steals the oldest task from another, so busy
+// workers are relieved without a shared queue everyone contends on.
+//
+// A task id may only be queued once at a time, so each queue needs room for every id and pushing
+// never allocates.
+class Scheduler{
+public:
+    // run(task, worker) is called for every pushed task on one of the workers
+    Scheduler(uint32_t tasks, std::function<void(uint32_t,uint32_t)> run, unsigned int threads = std::thread::hardware_concurrency())
+        : run(std::move(run)), queues(std::max(1u,threads)){
+        for(Queue &q : this->queues){
+            q.tasks.resize(tasks);
+        }
+        for(uint32_t i=0;i<this->queues.size();++i){
+            this->workers.emplace_back(&Scheduler::work,this,i);
+        }
+    }
+    Scheduler(const Scheduler&) = delete;
+    Scheduler &operator=(const Scheduler&) = delete;
+    // Runs what is still queued, then stops
+    ~Scheduler(){
+        {
+            std::lock_guard<std::mutex> lock(this->mutex);
+            this->stopping = true;
+        }
+        this->wake.notify_all();
+        for(std::thread &t : this->workers){
+            t.join();
+        }
+    }
+    unsigned int size() const {
+        return this->queues.size();
+    }
+    // Queues task on the next worker in turn
+    void push(uint32_t task){
+        this->push(task,this->next.fetch_add(1,std::memory_order_relaxed) % this->queues.size(),false);
+    }
+    // Queues task on worker behind everything already there, the first in line to be stolen. For
+    // tasks that requeue themselves from run, so they take turns with the rest.
+    void requeue(uint32_t task, uint32_t worker){
+        this->push(task,worker,true);
+    }
+private:
+    // Ring of task ids, newest at the back
+    struct alignas(64) Queue{
+        std::mutex mutex;
+        std::vector<uint32_t> tasks;
+        uint32_t head = 0, count = 0;
+    };
+    std::function<void(uint32_t,uint32_t)> run;
+    std::vector<Queue> queues;
+    std::vector<std::thread> workers;
+    std::atomic<uint32_t> next{0};
+    // Tasks in all queues together, workers sleep while it is 0
+    std::atomic<uint32_t> queued{0};
+    std::mutex mutex;
+    std::condition_variable wake;
+    bool stopping = false;
+
+    void push(uint32_t task, uint32_t worker, bool front){
+        Queue &q = this->queues[worker];
+        {
+            std::lock_guard<std::mutex> lock(q.mutex);
+            uint32_t size = q.tasks.size();
+            if(front){
+                q.head = (q.head+size-1) % size;
+                q.tasks[q.head] = task;
+            }else{
+                q.tasks[(q.head+q.count) % size] = task;
+            }
+            ++q.count;
+        }
+        this->queued.fetch_add(1,std::memory_order_release);
+        // Taking the lock orders this with a worker that is about to sleep
+        {
+            std::lock_guard<std::mutex> lock(this->mutex);
+        }
+        this->wake.notify_one();
+    }
+    // Newest task of worker's own queue, otherwise the oldest of the first other queue that has one
+    bool take(uint32_t worker, uint32_t &task){
+        uint32_t n = this->queues.size();
+        for(uint32_t k=0;k<n;++k){
+            Queue &q = this->queues[(worker+k) % n];
+            std::lock_guard<std::mutex> lock(q.mutex);
+            if(q.count == 0){
+                continue;
+            }
+            if(k == 0){
+                task = q.tasks[(q.head+q.count-1) % q.tasks.size()];
+            }else{
+                task = q.tasks[q.head];
+                q.head = (q.head+1) % q.tasks.size();
+            }
+            --q.count;
+            this->queued.fetch_sub(1,std::memory_order_relaxed);
+            return true;
+        }
+        return false;
+    }
+    void work(uint32_t worker){
+        uint32_t task;
+        while(true){
+            if(this->take(worker,task)){
+                this->run(task,worker);
+                continue;
+            }
+            std::unique_lock<std::mutex> lock(this->mutex);
+            this->wake.wait(lock,[this]{return this->stopping || this->queued.load(std::memory_order_acquire) > 0;});
+            if(this->stopping && this->queued.load(std::memory_order_acquire) == 0){
+                return;
+            }
+        }
+    }
+};
@@ -0,0 +1,188 @@
+#pragma once
+
+#include <cstdint>
+#include <cstring>
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "image.h"
+#include "detector.h"
+#include "scheduler.h"
+
+// Detection for several camera streams in one process. Every stream has its own detector, so
+// tracking and scratch memory are never shared, and a stream is only ever worked on by one thread at
+// a time. Streams are spread over the cores by a work-stealing Scheduler, one frame per turn.
+//
+// Each stream keeps the last depth frames that are still waiting. When a new frame arrives and none
+// are left, the oldest waiting frame is stale and dropped, so a slow stream keeps up with its camera
+// instead of falling further behind.
+namespace service{
+    struct Result{
+        uint32_t stream;
+        // Numbered per stream in order of submission, dropped frames leave gaps
+        uint64_t frame;
+        // The frame itself, only valid during the call
+        const rgba *pixels;
+        uint32_t width, height;
+        detector::Detection detection;
+    };
+
+    class Service{
+    public:
+        // handler gets every result on a worker thread. Results of one stream arrive in frame order
+        // and never overlap, different streams may be handled at the same time.
+        Service(const detector::Config &config, uint32_t streams, uint32_t width, uint32_t height, std::function<void(const Result&)> handler,
+            unsigned int threads = std::thread::hardware_concurrency(), uint32_t depth = 2)
+            : width(width), height(height), handler(std::move(handler)){
+            for(uint32_t i=0;i<streams;++i){
+                // At least one frame has to be able to wait while another is worked on
+                this->streams.push_back(std::make_unique<Stream>(config,width,height,std::max(depth,1u)));
+            }
+            this->scheduler = std::make_unique<Scheduler>(streams,[this](uint32_t stream, uint32_t worker){this->step(stream,worker);},threads);
+        }
+        Service(const Service&) = delete;
+        Service &operator=(const Service&) = delete;
+        // Finishes every frame still waiting
+        ~Service(){
+            this->scheduler.reset();
+        }
+        // Copies a frame into the stream. Frames of one stream must be submitted from one thread at
+        // a time. False if a stale frame was dropped to make room.
+        bool submit(uint32_t stream, const rgba *pixels, uint32_t stride){
+            Stream &s = *this->streams[stream];
+            uint32_t slot;
+            bool dropped = false;
+            {
+                std::lock_guard<std::mutex> lock(s.mutex);
+                // With a depth of at least 1, no free slot means a frame is waiting, the worker only
+                // ever holds one
+                if(s.free.empty() && s.count > 0){
+                    slot = s.waiting[s.head];
+                    s.head = (s.head+1) % s.waiting.size();
+                    --s.count;
+                    ++s.dropped;
+                    dropped = true;
+                }else{
+                    slot = s.free.back();
+                    s.free.pop_back();
+                }
+                s.frames[slot] = s.submitted++;
+            }
+            rgba *dst = s.slots[slot].data();
+            for(uint32_t y=0;y<this->height;++y){
+                memcpy(dst+y*this->width,pixels+y*stride,this->width*sizeof(rgba));
+            }
+            bool schedule;
+            {
+                std::lock_guard<std::mutex> lock(s.mutex);
+                s.waiting[(s.head+s.count) % s.waiting.size()] = slot;
+                ++s.count;
+                schedule = !s.scheduled;
+                s.scheduled = true;
+            }
+            if(!dropped){
+                this->outstanding.fetch_add(1,std::memory_order_relaxed);
+            }
+            if(schedule){
+                this->scheduler->push(stream);
+            }
+            return !dropped;
+        }
+        // Waits until every submitted frame has been handled or dropped
+        void drain(){
+            std::unique_lock<std::mutex> lock(this->idleMutex);
+            this->idle.wait(lock,[this]{return this->outstanding.load(std::memory_order_acquire) == 0;});
+        }
+        uint32_t size() const {
+            return this->streams.size();
+        }
+        uint64_t processed(uint32_t stream){
+            Stream &s = *this->streams[stream];
+            std::lock_guard<std::mutex> lock(s.mutex);
+            return s.processed;
+        }
+        uint64_t dropped(uint32_t stream){
+            Stream &s = *this->streams[stream];
+            std::lock_guard<std::mutex> lock(s.mutex);
+            return s.dropped;
+        }
+    private:
+        struct Stream{
+            Stream(const detector::Config &config, uint32_t width, uint32_t height, uint32_t depth)
+                : detector(config), slots(depth+1,std::vector<rgba>((size_t)width*height)), frames(depth+1), waiting(depth+1){
+                for(uint32_t i=0;i<=depth;++i){
+                    this->free.push_back(i);
+                }
+            }
+            // No pool, the streams are what runs in parallel
+            detector::Detector detector;
+            // One slot per waiting frame plus the one being worked on
+            std::vector<std::vector<rgba>> slots;
+            std::vector<uint64_t> frames;
+            std::mutex mutex;
+            std::vector<uint32_t> free;
+            // Ring of waiting slots, oldest at head
+            std::vector<uint32_t> waiting;
+            uint32_t head = 0, count = 0;
+            // Queued on the scheduler or being worked on
+            bool scheduled = false;
+            uint64_t submitted = 0, processed = 0, dropped = 0;
+        };
+        uint32_t width, height;
+        std::function<void(const Result&)> handler;
+        std::vector<std::unique_ptr<Stream>> streams;
+        std::unique_ptr<Scheduler> scheduler;
+        std::atomic<uint64_t> outstanding{0};
+        std::mutex idleMutex;
+        std::condition_variable idle;
+
+        // Works on the oldest waiting frame of stream, then hands the stream back to the scheduler
+        // if more are waiting
+        void step(uint32_t stream, uint32_t worker){
+            Stream &s = *this->streams[stream];
+            uint32_t slot;
+            uint64_t frame;
+            {
+                std::lock_guard<std::mutex> lock(s.mutex);
+                // A submit may have taken the only waiting frame and not put its own in yet
+                if(s.count == 0){
+                    s.scheduled = false;
+                    return;
+                }
+                slot = s.waiting[s.head];
+                s.head = (s.head+1) % s.waiting.size();
+                --s.count;
+                frame = s.frames[slot];
+            }
+            Result res;
+            res.stream = stream;
+            res.frame = frame;
+            res.pixels = s.slots[slot].data();
+            res.width = this->width;
+            res.height = this->height;
+            res.detection = s.detector.detect(res.pixels,this->width,this->height,this->width);
+            this->handler(res);
+            bool more;
+            {
+                std::lock_guard<std::mutex> lock(s.mutex);
+                s.free.push_back(slot);
+                ++s.processed;
+                more = s.count > 0;
+                s.scheduled = more;
+            }
+            if(more){
+                this->scheduler->requeue(stream,worker);
+            }
+            if(this->outstanding.fetch_sub(1,std::memory_order_acq_rel) == 1){
+                std::lock_guard<std::mutex> lock(this->idleMutex);
+                this->idle.notify_all();
+            }
+        }
+    };
+}
@@ -0,0 +1,110 @@
+#pragma once
+
+#include <cstdint>
+
+#if defined(__AVX2__) || defined(__SSE2__)
+#include <immintrin.h>
+#endif
+
+#include "image.h"
+
+namespace simd{
+    // Per channel |pixel - color| < tolerance, stored as an inclusive limit so it maps onto saturating subtracts
+    struct ColorRange{
+        uint32_t color;
+        uint32_t limit;
+        bool empty;
+        ColorRange(rgba color, uint8_t tr, uint8_t tg, uint8_t tb, uint8_t ta = 255){
+            this->color = color;
+            this->empty = tr == 0 || tg == 0 || tb == 0 || ta == 0;
+            rgba lim = {(uint8_t)(tr-1),(uint8_t)(tg-1),(uint8_t)(tb-1),(uint8_t)(ta-1)};
+            this->limit = lim;
+        }
+        bool test(rgba c) const {
+            if(this->empty){
+                return false;
+            }
+            const rgba &col = *(const rgba*)&this->color;
+            const rgba &lim = *(const rgba*)&this->limit;
+            return std::abs((int)c.r - (int)col.r) <= lim.r && std::abs((int)c.g - (int)col.g) <= lim.g
+                && std::abs((int)c.b - (int)col.b) <= lim.b && std::abs((int)c.a - (int)col.a) <= lim.a;
+        }
+    };
+
+    // Bit i of the result is set if p[i] is inside the range, for 8 consecutive pixels
+    uint32_t match8(const rgba *p, const ColorRange &range){
+        if(range.empty){
+            return 0;
+        }
+#if defined(__AVX2__)
+        __m256i px = _mm256_loadu_si256((const __m256i*)p);
+        __m256i col = _mm256_set1_epi32(range.color);
+        __m256i diff = _mm256_or_si256(_mm256_subs_epu8(px,col),_mm256_subs_epu8(col,px));
+        __m256i over = _mm256_subs_epu8(diff,_mm256_set1_epi32(range.limit));
+        __m256i ok = _mm256_cmpeq_epi32(over,_mm256_setzero_si256());
+        return _mm256_movemask_ps(_mm256_castsi256_ps(ok));
+#elif defined(__SSE2__)
+        __m128i col = _mm_set1_epi32(range.color);
+        __m128i lim = _mm_set1_epi32(range.limit);
+        uint32_t res = 0;
+        for(int i=0;i<2;++i){
+            __m128i px = _mm_loadu_si128((const __m128i*)(p+4*i));
+            __m128i diff = _mm_or_si128(_mm_subs_epu8(px,col),_mm_subs_epu8(col,px));
+            __m128i ok = _mm_cmpeq_epi32(_mm_subs_epu8(diff,lim),_mm_setzero_si128());
+            res |= _mm_movemask_ps(_mm_castsi128_ps(ok)) << (4*i);
+        }
+        return res;
+#else
+        uint32_t res = 0;
+        for(int i=0;i<8;++i){
+            res |= (uint32_t)range.test(p[i]) << i;
+        }
+        return res;
+#endif
+    }
+
+    // Index of the first pixel in [begin,end) inside the range, or end
+    uint32_t firstMatch(const rgba *row, uint32_t begin, uint32_t end, const ColorRange &range){
+        uint32_t x = begin;
+        for(;x+8<=end;x+=8){
+            uint32_t m = match8(row+x,range);
+            if(m){
+                return x + __builtin_ctz(m);
+            }
+        }
+        for(;x<end;++x){
+            if(range.test(row[x])){
+                return x;
+            }
+        }
+        return end;
+    }
+
+    // Index of the last pixel in [begin,end) inside the range, or end
+    uint32_t lastMatch(const rgba *row, uint32_t begin, uint32_t end, const ColorRange &range){
+        uint32_t x = end;
+        for(;x>=begin+8;x-=8){
+            uint32_t m = match8(row+x-8,range);
+            if(m){
+                return x - 8 + 31 - __builtin_clz(m);
+            }
+        }
+        while(x>begin){
+            --x;
+            if(range.test(row[x])){
+                return x;
+            }
+        }
+        return end;
+    }
+}
+
+namespace match{
+    // Runtime color and tolerance with the tolerance arithmetic done once, when the range was built
+    struct Range{
+        const simd::ColorRange &range;
+        bool operator()(rgba c) const {
+            return this->range.test(c);
+        }
+    };
+}
@@ -0,0 +1,99 @@
+#pragma once
+
+#include <cstdint>
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// A few preallocated slots the frame loop fills and a thread of their own writes out, oldest first.
+// When every slot is still waiting to be written the new one is dropped, so the frame loop never
+// waits on disk. Taking and handing back slots does not allocate, the slot indices never outgrow
+// the slot count.
+//
+// write runs on the writer thread and usually reaches into the owner, so the owner declares its
+// SlotWriter last: it is destroyed first and has written out everything queued before the rest of
+// the owner goes away.
+template<typename Slot>
+class SlotWriter{
+public:
+    // write(slot) is called for every slot pushed
+    SlotWriter(uint32_t count, std::function<void(Slot&)> write)
+        : write(std::move(write)), slots(count), ready(count){
+        for(uint32_t i=0;i<count;++i){
+            this->free.push_back(i);
+        }
+        this->writer = std::thread(&SlotWriter::drain,this);
+    }
+    SlotWriter(const SlotWriter&) = delete;
+    SlotWriter &operator=(const SlotWriter&) = delete;
+    // Writes out everything still queued
+    ~SlotWriter(){
+        {
+            std::lock_guard<std::mutex> lock(this->mutex);
+            this->stopping = true;
+        }
+        this->wake.notify_one();
+        this->writer.join();
+    }
+    uint32_t size() const {
+        return this->slots.size();
+    }
+    // For preallocating before anything is pushed
+    Slot &operator[](uint32_t index){
+        return this->slots[index];
+    }
+    // A slot to fill, or nullptr if every slot is still waiting; that counts as dropped
+    Slot *take(){
+        std::lock_guard<std::mutex> lock(this->mutex);
+        if(this->free.empty()){
+            ++this->lost;
+            return nullptr;
+        }
+        uint32_t index = this->free.back();
+        this->free.pop_back();
+        return &this->slots[index];
+    }
+    // Queues a slot from take() to be written
+    void push(Slot *slot){
+        {
+            std::lock_guard<std::mutex> lock(this->mutex);
+            this->ready[(this->readyHead+this->readyCount++) % this->ready.size()] = slot - this->slots.data();
+        }
+        this->wake.notify_one();
+    }
+    uint64_t dropped(){
+        std::lock_guard<std::mutex> lock(this->mutex);
+        return this->lost;
+    }
+private:
+    std::function<void(Slot&)> write;
+    std::vector<Slot> slots;
+    std::mutex mutex;
+    std::condition_variable wake;
+    // Slot indices, ready ones in a ring with the oldest at readyHead
+    std::vector<uint32_t> free;
+    std::vector<uint32_t> ready;
+    uint32_t readyHead = 0, readyCount = 0;
+    uint64_t lost = 0;
+    bool stopping = false;
+    std::thread writer;
+
+    void drain(){
+        std::unique_lock<std::mutex> lock(this->mutex);
+        while(true){
+            this->wake.wait(lock,[this]{return this->stopping || this->readyCount > 0;});
+            if(this->readyCount == 0){
+                break;
+            }
+            uint32_t index = this->ready[this->readyHead];
+            this->readyHead = (this->readyHead+1) % this->ready.size();
+            --this->readyCount;
+            lock.unlock();
+            this->write(this->slots[index]);
+            lock.lock();
+            this->free.push_back(index);
+        }
+    }
+};
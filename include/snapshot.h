@@ -0,0 +1,180 @@
+#pragma once
+
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <string>
+#include <system_error>
+#include <vector>
+
+#include "image.h"
+#include "slot_writer.h"
+
+// Snapshots of the pad section written on a background thread. The frame loop only copies the
+// pixels into a SlotWriter slot, so holding the snapshot key never slows the loop down.
+namespace snapshot{
+    enum Format{
+        // Small files, slow to encode
+        PNG,
+        // Lossless and much faster to encode than PNG
+        QOI,
+        // Uncompressed, fastest
+        TGA
+    };
+    const char *extension(Format format){
+        switch(format){
+            case QOI: return ".qoi";
+            case TGA: return ".tga";
+            default: return ".png";
+        }
+    }
+
+    // https://qoiformat.org/qoi-specification.pdf, 4 channels, sRGB
+    void encodeQoi(const rgba *pixels, uint32_t width, uint32_t height, std::vector<uint8_t> &out){
+        out.clear();
+        out.reserve(14 + (size_t)width*height*5 + 8);
+        auto u32 = [&](uint32_t v){
+            for(int s=24;s>=0;s-=8){
+                out.push_back(v >> s);
+            }
+        };
+        out.insert(out.end(),{'q','o','i','f'});
+        u32(width);
+        u32(height);
+        out.push_back(4);
+        out.push_back(0);
+
+        rgba index[64] = {};
+        rgba prev = {0,0,0,255};
+        uint32_t run = 0;
+        size_t count = (size_t)width*height;
+        for(size_t i=0;i<count;++i){
+            rgba px = pixels[i];
+            if((uint32_t)px == (uint32_t)prev){
+                if(++run == 62 || i == count-1){
+                    out.push_back(0xc0 | (run-1));
+                    run = 0;
+                }
+                continue;
+            }
+            if(run > 0){
+                out.push_back(0xc0 | (run-1));
+                run = 0;
+            }
+            uint32_t h = (px.r*3 + px.g*5 + px.b*7 + px.a*11) % 64;
+            if((uint32_t)index[h] == (uint32_t)px){
+                out.push_back(h);
+            }else{
+                index[h] = px;
+                if(px.a == prev.a){
+                    int8_t dr = px.r-prev.r, dg = px.g-prev.g, db = px.b-prev.b;
+                    int8_t drg = dr-dg, dbg = db-dg;
+                    if(dr >= -2 && dr <= 1 && dg >= -2 && dg <= 1 && db >= -2 && db <= 1){
+                        out.push_back(0x40 | (dr+2) << 4 | (dg+2) << 2 | (db+2));
+                    }else if(dg >= -32 && dg <= 31 && drg >= -8 && drg <= 7 && dbg >= -8 && dbg <= 7){
+                        out.push_back(0x80 | (dg+32));
+                        out.push_back((drg+8) << 4 | (dbg+8));
+                    }else{
+                        out.insert(out.end(),{0xfe,px.r,px.g,px.b});
+                    }
+                }else{
+                    out.insert(out.end(),{0xff,px.r,px.g,px.b,px.a});
+                }
+            }
+            prev = px;
+        }
+        out.insert(out.end(),{0,0,0,0,0,0,0,1});
+    }
+
+    class Encoder{
+    public:
+        // Files are named prefix_000000.png, prefix_000000_annotated.png and so on, numbered in the
+        // order snapshots are taken
+        Encoder(const std::filesystem::path &prefix, Format format = PNG, uint32_t slots = 4)
+            : prefix(prefix.string()), format(format), queue(slots,[this](Slot &slot){this->save(slot);}){
+            std::error_code error;
+            if(prefix.has_parent_path()){
+                std::filesystem::create_directories(prefix.parent_path(),error);
+            }
+            // Room for the longest name, "_annotated" and the number included
+            this->name.resize(this->prefix.size()+64);
+        }
+        Encoder(const Encoder&) = delete;
+        Encoder &operator=(const Encoder&) = delete;
+        // Copies the view and its annotations, if it has any. False if the snapshot was dropped.
+        bool push(const ImageView &view){
+            Slot *taken = this->queue.take();
+            if(!taken){
+                return false;
+            }
+            Slot &slot = *taken;
+            slot.sequence = this->taken++;
+            slot.width = view.width;
+            slot.height = view.height;
+            slot.annotated = view.annotated != nullptr;
+            size_t size = (size_t)view.width*view.height;
+            // Only grows while larger pads than before are saved
+            slot.pixels.resize(size);
+            for(int y=0;y<view.height;++y){
+                memcpy(slot.pixels.data()+y*view.width,view.pixels+y*view.stride,view.width*sizeof(rgba));
+            }
+            if(slot.annotated){
+                slot.annotations.resize(size);
+                memcpy(slot.annotations.data(),view.annotated,size*sizeof(rgba));
+            }
+            if(this->format == QOI){
+                // The worst case of encodeQoi, so the writer never grows it
+                slot.encoded.reserve(14 + size*5 + 8);
+            }
+            this->queue.push(&slot);
+            return true;
+        }
+        uint64_t dropped(){
+            return this->queue.dropped();
+        }
+    private:
+        struct Slot{
+            uint64_t sequence;
+            int width, height;
+            bool annotated;
+            std::vector<rgba> pixels, annotations;
+            std::vector<uint8_t> encoded;
+        };
+        std::string prefix;
+        Format format;
+        uint64_t taken = 0;
+        // File names are built in here on the writer thread. The frame loop checks that nothing
+        // allocates, and that counts the writer too.
+        std::vector<char> name;
+        SlotWriter<Slot> queue;
+
+        // On the writer thread
+        void save(Slot &slot){
+            unsigned long long number = slot.sequence;
+            snprintf(this->name.data(),this->name.size(),"%s_%06llu%s",this->prefix.c_str(),number,extension(this->format));
+            this->write(this->name.data(),slot,slot.pixels.data());
+            // Like ImageView::save, the annotated file is always written
+            snprintf(this->name.data(),this->name.size(),"%s_%06llu_annotated%s",this->prefix.c_str(),number,extension(this->format));
+            this->write(this->name.data(),slot,slot.annotated ? slot.annotations.data() : slot.pixels.data());
+        }
+        void write(const char *name, Slot &slot, const rgba *pixels){
+            switch(this->format){
+                case PNG:{
+                    stbi_write_png(name,slot.width,slot.height,4,pixels,4*slot.width);
+                }break;
+                case QOI:{
+                    encodeQoi(pixels,slot.width,slot.height,slot.encoded);
+                    if(FILE *file = fopen(name,"wb")){
+                        fwrite(slot.encoded.data(),1,slot.encoded.size(),file);
+                        fclose(file);
+                    }
+                }break;
+                case TGA:{
+                    stbi_write_tga_with_rle = 0;
+                    stbi_write_tga(name,slot.width,slot.height,4,pixels);
+                }break;
+            }
+        }
+    };
+}
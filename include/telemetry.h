@@ -0,0 +1,151 @@
+#pragma once
+
+#include <cstdint>
+#include <cstring>
+#include <atomic>
+#include <chrono>
+#include <thread>
+#include <vector>
+#include <iostream>
+
+#include "detector.h"
+
+// Per-frame results handed off to a background thread, so the frame loop never waits on stdout
+// or a file.
+namespace telemetry{
+    struct record{
+        uint64_t frame;
+        // Nanoseconds since the channel was opened
+        uint64_t timestamp;
+        int32_t accuracy;
+        float pos[3];
+        float yaw, pitch;
+        double calculated;
+        double actual;
+    };
+
+    // Lock free ring for exactly one producer and one consumer
+    class Ring{
+    public:
+        // Capacity is rounded up to a power of two
+        Ring(uint32_t capacity){
+            uint32_t size = 1;
+            while(size < capacity){
+                size <<= 1;
+            }
+            this->records.resize(size);
+            this->mask = size-1;
+        }
+        // False if the ring is full
+        bool push(const record &r){
+            uint64_t h = this->head.load(std::memory_order_relaxed);
+            if(h - this->tail.load(std::memory_order_acquire) > this->mask){
+                return false;
+            }
+            this->records[h & this->mask] = r;
+            this->head.store(h+1,std::memory_order_release);
+            return true;
+        }
+        // False if the ring is empty
+        bool pop(record &r){
+            uint64_t t = this->tail.load(std::memory_order_relaxed);
+            if(t == this->head.load(std::memory_order_acquire)){
+                return false;
+            }
+            r = this->records[t & this->mask];
+            this->tail.store(t+1,std::memory_order_release);
+            return true;
+        }
+    private:
+        std::vector<record> records;
+        uint64_t mask;
+        // Kept on separate cache lines so the two threads do not share one
+        alignas(64) std::atomic<uint64_t> head{0};
+        alignas(64) std::atomic<uint64_t> tail{0};
+    };
+
+    enum Format{
+        // Same lines detector::print writes
+        TEXT,
+        // "LPT2", record size as uint32_t, then raw records. LPT1 streams predate the MOMENTS
+        // accuracy, their BORDER is 2.
+        BINARY
+    };
+
+    class Channel{
+    public:
+        Channel(std::ostream &out, Format format, uint32_t capacity = 1024)
+            : out(out), format(format), ring(capacity), start(std::chrono::steady_clock::now()){
+            if(format == BINARY){
+                uint32_t size = sizeof(record);
+                out.write("LPT2",4);
+                out.write((const char*)&size,sizeof(size));
+            }
+            this->writer = std::thread(&Channel::drain,this);
+        }
+        Channel(const Channel&) = delete;
+        Channel &operator=(const Channel&) = delete;
+        // Writes out everything still queued
+        ~Channel(){
+            this->running.store(false,std::memory_order_release);
+            this->writer.join();
+            this->out.flush();
+        }
+        // Never blocks, the record is dropped and counted if the writer has fallen behind
+        void push(uint64_t frame, const detector::Detection &detection, double actual, const float pos[3], float yaw, float pitch){
+            record r;
+            r.frame = frame;
+            r.timestamp = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now()-this->start).count();
+            r.accuracy = detection.accuracy;
+            memcpy(r.pos,pos,sizeof(r.pos));
+            r.yaw = yaw;
+            r.pitch = pitch;
+            r.calculated = detection.calculatedDistance;
+            r.actual = actual;
+            if(!this->ring.push(r)){
+                this->lost.fetch_add(1,std::memory_order_relaxed);
+            }
+        }
+        uint64_t dropped() const {
+            return this->lost.load(std::memory_order_relaxed);
+        }
+    private:
+        void drain(){
+            record r;
+            while(true){
+                // Read the flag first so nothing pushed before the destructor is missed
+                bool stopping = !this->running.load(std::memory_order_acquire);
+                bool any = false;
+                while(this->ring.pop(r)){
+                    this->write(r);
+                    any = true;
+                }
+                if(stopping){
+                    return;
+                }
+                if(any){
+                    this->out.flush();
+                }else{
+                    std::this_thread::sleep_for(std::chrono::milliseconds(2));
+                }
+            }
+        }
+        void write(const record &r){
+            if(this->format == BINARY){
+                this->out.write((const char*)&r,sizeof(r));
+            }else{
+                detector::Detection detection;
+                detection.accuracy = r.accuracy;
+                detection.calculatedDistance = r.calculated;
+                detector::print(this->out,detection,r.actual);
+            }
+        }
+        std::ostream &out;
+        Format format;
+        Ring ring;
+        std::chrono::steady_clock::time_point start;
+        std::atomic<bool> running{true};
+        std::atomic<uint64_t> lost{0};
+        std::thread writer;
+    };
+}
@@ -0,0 +1,106 @@
+#pragma once
+
+#include <cstdint>
+#include <cstring>
+#include <cstdio>
+#include <chrono>
+#include <fstream>
+#include <filesystem>
+#include <system_error>
+
+#include "mapped_file.h"
+#include "raster.h"
+
+// Generated textures stored on disk by a hash of everything that produced them, so a restart maps
+// the file instead of running the filters again.
+namespace texcache{
+    // Payload starts here, a cache line in so the texels stay aligned
+    constexpr uint32_t HEADER_SIZE = 64;
+
+    // Everything the texture depends on. Bump version whenever the generator's output changes.
+    struct Key{
+        uint32_t version;
+        int32_t width, height;
+        uint32_t params[8];
+    };
+    struct Header{
+        char magic[4];
+        uint32_t headerSize;
+        Key key;
+        uint64_t payloadSize;
+    };
+    static_assert(sizeof(Header) <= HEADER_SIZE);
+
+    // FNV-1a over the key
+    uint64_t hash(const Key &key){
+        const uint8_t *p = (const uint8_t*)&key;
+        uint64_t h = 0xcbf29ce484222325ULL;
+        for(size_t i=0;i<sizeof(Key);++i){
+            h = (h ^ p[i]) * 0x100000001b3ULL;
+        }
+        return h;
+    }
+    std::filesystem::path path(const Key &key, const std::filesystem::path &dir){
+        char name[32];
+        snprintf(name,sizeof(name),"%016llx.rgba",(unsigned long long)hash(key));
+        return dir / name;
+    }
+    uint32_t *pixels(const MappedFile &file){
+        return (uint32_t*)(file.data()+HEADER_SIZE);
+    }
+    // True if file holds exactly the texture described by key
+    bool valid(const MappedFile &file, const Key &key){
+        if(file.size() < HEADER_SIZE){
+            return false;
+        }
+        const Header &header = *(const Header*)file.data();
+        uint64_t payload = 4ULL*key.width*key.height;
+        return memcmp(header.magic,"LPTX",4) == 0 && header.headerSize == HEADER_SIZE
+            && memcmp(&header.key,&key,sizeof(Key)) == 0 && header.payloadSize == payload
+            && file.size() == HEADER_SIZE + payload;
+    }
+
+    // Maps the texture for key from dir. On a miss generate(raster::Texture&) fills a fresh texture,
+    // which is written under a temporary name and renamed into place so readers never see half a file.
+    // False if the cache cannot be read or written, the caller then generates in memory.
+    template<typename F>
+    bool load(const Key &key, const std::filesystem::path &dir, MappedFile &file, F &&generate){
+        std::filesystem::path target = path(key,dir);
+        if(file.open(target) && valid(file,key)){
+            return true;
+        }
+        file.close();
+
+        std::error_code error;
+        std::filesystem::create_directories(dir,error);
+        raster::Texture texture(key.width,key.height);
+        generate(texture);
+
+        Header header = {};
+        memcpy(header.magic,"LPTX",4);
+        header.headerSize = HEADER_SIZE;
+        header.key = key;
+        header.payloadSize = 4ULL*key.width*key.height;
+        uint8_t block[HEADER_SIZE] = {};
+        memcpy(block,&header,sizeof(header));
+
+        std::filesystem::path temp = target;
+        temp += ".tmp" + std::to_string(std::chrono::steady_clock::now().time_since_epoch().count());
+        {
+            std::ofstream out(temp,std::ios::binary);
+            out.write((const char*)block,HEADER_SIZE);
+            out.write((const char*)texture.buffer,header.payloadSize);
+            if(!out){
+                out.close();
+                std::filesystem::remove(temp,error);
+                return false;
+            }
+        }
+        std::filesystem::rename(temp,target,error);
+        if(error){
+            std::filesystem::remove(temp,error);
+            return false;
+        }
+        return file.open(target) && valid(file,key);
+    }
+}
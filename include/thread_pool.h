@@ -0,0 +1,138 @@
+#pragma once
+
+#include <cstdint>
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#include <type_traits>
+#include <vector>
+
+// Workers started once and reused for every data parallel loop. The calling thread takes part
+// in each loop, so a pool of size n starts n-1 threads.
+class ThreadPool{
+public:
+    ThreadPool(unsigned int threads = std::thread::hardware_concurrency()){
+        for(unsigned int i=1;i<threads;++i){
+            this->workers.emplace_back(&ThreadPool::run,this);
+        }
+    }
+    ThreadPool(const ThreadPool&) = delete;
+    ThreadPool &operator=(const ThreadPool&) = delete;
+    ~ThreadPool(){
+        {
+            std::lock_guard<std::mutex> lock(this->mutex);
+            this->stopping = true;
+        }
+        this->wake.notify_all();
+        for(std::thread &t : this->workers){
+            t.join();
+        }
+    }
+    unsigned int size() const {
+        return this->workers.size()+1;
+    }
+    // Calls f(i) for every i in [0,count) across the pool and returns once all calls are done
+    template<typename F>
+    void parallelFor(int count, F &&f){
+        if(this->workers.empty() || count <= 1){
+            for(int i=0;i<count;++i){
+                f(i);
+            }
+            return;
+        }
+        {
+            std::lock_guard<std::mutex> lock(this->mutex);
+            this->fn = [](void *ctx, int i){(*(std::remove_reference_t<F>*)ctx)(i);};
+            this->ctx = (void*)&f;
+            this->count = count;
+            this->next = 0;
+            this->active = this->workers.size();
+            ++this->generation;
+        }
+        this->wake.notify_all();
+        this->work();
+        std::unique_lock<std::mutex> lock(this->mutex);
+        this->finished.wait(lock,[this]{return this->active == 0;});
+    }
+private:
+    std::vector<std::thread> workers;
+    std::mutex mutex;
+    std::condition_variable wake, finished;
+    uint64_t generation = 0;
+    unsigned int active = 0;
+    bool stopping = false;
+
+    void (*fn)(void*,int) = nullptr;
+    void *ctx = nullptr;
+    int count = 0;
+    std::atomic<int> next{0};
+
+    void work(){
+        for(int i = this->next++;i < this->count;i = this->next++){
+            this->fn(this->ctx,i);
+        }
+    }
+    void run(){
+        uint64_t seen = 0;
+        while(true){
+            {
+                std::unique_lock<std::mutex> lock(this->mutex);
+                this->wake.wait(lock,[&]{return this->stopping || this->generation != seen;});
+                if(this->stopping){
+                    return;
+                }
+                seen = this->generation;
+            }
+            this->work();
+            {
+                std::lock_guard<std::mutex> lock(this->mutex);
+                if(--this->active == 0){
+                    this->finished.notify_one();
+                }
+            }
+        }
+    }
+};
+
+// Rows [0,height) split into bands for one pass across a pool, or run in order without one. Up to
+// four bands per thread so uneven bands even out; none shorter than MIN_ROWS, fewer rows than that
+// are not worth handing to another thread.
+class RowBands{
+public:
+    static constexpr uint32_t MIN_ROWS = 16;
+
+    RowBands(ThreadPool *pool, uint32_t height)
+        : pool(pool), height(height), count(std::max(1u,std::min(most(pool),height/MIN_ROWS))){}
+    // The most bands any split over pool has, to size per band results once up front
+    static uint32_t most(ThreadPool *pool){
+        return 4*(pool ? pool->size() : 1);
+    }
+    uint32_t size() const {
+        return this->count;
+    }
+    uint32_t begin(uint32_t band) const {
+        return this->height*band/this->count;
+    }
+    uint32_t end(uint32_t band) const {
+        return this->height*(band+1)/this->count;
+    }
+    // Calls f(band,begin,end) for every band and returns once all calls are done
+    template<typename F>
+    void run(F &&f) const {
+        auto band = [&](int i){
+            f((uint32_t)i,this->begin(i),this->end(i));
+        };
+        if(this->pool){
+            this->pool->parallelFor(this->count,band);
+        }else{
+            for(uint32_t i=0;i<this->count;++i){
+                band(i);
+            }
+        }
+    }
+private:
+    ThreadPool *pool;
+    uint32_t height, count;
+};
@@ -0,0 +1,55 @@
+#pragma once
+
+#include <cstdint>
+#include <cstdlib>
+#include <algorithm>
+
+#include "image.h"
+#include "bounds.h"
+
+// Remembers where the pad was last frame and predicts where it will be next, assuming it keeps
+// moving the way it moved between the last two frames
+class Tracker{
+public:
+    bool tracking = false;
+    bounds::box extent;
+    point major1, major2;
+    bool rMajor;
+    // Pixels added around the predicted extents
+    int margin = 8;
+    void update(const bounds::box &extent, point major1, point major2, bool rMajor){
+        if(this->tracking){
+            this->dMin = extent.min-this->extent.min;
+            this->dMax = extent.max-this->extent.max;
+        }else{
+            this->dMin = {0,0};
+            this->dMax = {0,0};
+        }
+        this->extent = extent;
+        this->major1 = major1;
+        this->major2 = major2;
+        this->rMajor = rMajor;
+        this->tracking = true;
+    }
+    void lose(){
+        this->tracking = false;
+    }
+    // Area to search this frame, clamped to the frame
+    bounds::box window(uint32_t width, uint32_t height){
+        int slack = this->margin + std::max({std::abs(this->dMin.dx),std::abs(this->dMin.dy),std::abs(this->dMax.dx),std::abs(this->dMax.dy)});
+        int minX = (int)this->extent.min.x + this->dMin.dx - slack;
+        int minY = (int)this->extent.min.y + this->dMin.dy - slack;
+        int maxX = (int)this->extent.max.x + this->dMax.dx + slack;
+        int maxY = (int)this->extent.max.y + this->dMax.dy + slack;
+        return {
+            {(uint32_t)std::max(minX,0),(uint32_t)std::max(minY,0)},
+            {(uint32_t)std::min(maxX,(int)width-1),(uint32_t)std::min(maxY,(int)height-1)}
+        };
+    }
+    // Where a point on the pad should be this frame
+    point predict(point p){
+        return p + direction{(this->dMin.dx+this->dMax.dx)/2,(this->dMin.dy+this->dMax.dy)/2};
+    }
+private:
+    direction dMin = {0,0}, dMax = {0,0};
+};
@@ -0,0 +1,225 @@
+#pragma once
+
+#include <cstdint>
+#include <algorithm>
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#endif
+
+#include "image.h"
+
+// Camera frames in NV12 (a Y plane, then one interleaved UV plane at half resolution both ways) or
+// YUYV (Y0 U Y1 V for every two pixels), classified where they are. Colours are BT.601 limited
+// range, which is what the cameras deliver. A frame is 1.5 (NV12) or 2 (YUYV) bytes per pixel to
+// read instead of 4, and nothing converts it to RGBA first.
+namespace yuv{
+    enum Format{
+        NV12,
+        YUYV
+    };
+
+    // Wraps buffers the caller owns. Widths are even, chroma always covers two pixels of a row.
+    struct Frame{
+        Format format;
+        const uint8_t *luma;
+        // The UV plane for NV12, unused for YUYV
+        const uint8_t *chroma;
+        uint32_t width, height;
+        // Bytes per row of each plane
+        uint32_t lumaStride, chromaStride;
+
+        static Frame nv12(const uint8_t *luma, const uint8_t *chroma, uint32_t width, uint32_t height, uint32_t lumaStride, uint32_t chromaStride){
+            return {NV12,luma,chroma,width,height,lumaStride,chromaStride};
+        }
+        // An NV12 buffer with the UV plane straight after height rows of Y
+        static Frame nv12(const uint8_t *data, uint32_t width, uint32_t height, uint32_t stride){
+            return nv12(data,data+(size_t)stride*height,width,height,stride,stride);
+        }
+        static Frame yuyv(const uint8_t *data, uint32_t width, uint32_t height, uint32_t stride){
+            return {YUYV,data,nullptr,width,height,stride,0};
+        }
+        void pixel(uint32_t x, uint32_t y, uint8_t &py, uint8_t &pu, uint8_t &pv) const {
+            if(this->format == NV12){
+                const uint8_t *uv = this->chroma + (y >> 1)*this->chromaStride + (x & ~1u);
+                py = this->luma[y*this->lumaStride + x];
+                pu = uv[0];
+                pv = uv[1];
+            }else{
+                const uint8_t *pair = this->luma + y*this->lumaStride + 2*(x & ~1u);
+                py = pair[2*(x & 1)];
+                pu = pair[1];
+                pv = pair[3];
+            }
+        }
+    };
+
+    inline void fromRgb(int r, int g, int b, int &y, int &u, int &v){
+        y = ((66*r + 129*g + 25*b + 128) >> 8) + 16;
+        u = ((-38*r - 74*g + 112*b + 128) >> 8) + 128;
+        v = ((112*r - 94*g - 18*b + 128) >> 8) + 128;
+    }
+
+    // The YUV box around everything simd::ColorRange accepts for the same colour and tolerances.
+    // Each of Y, U and V is monotonic in every channel, so its extremes over the RGB box are at the
+    // corners picked by the signs of its weights. The box holds more than the RGB box maps to, and
+    // is one wider on each side for converters that round differently.
+    struct Range{
+        uint8_t lo[3], hi[3];
+        bool empty;
+        Range(rgba color, uint8_t tr, uint8_t tg, uint8_t tb){
+            this->empty = tr == 0 || tg == 0 || tb == 0;
+            int rl = std::max(color.r-tr+1,0), rh = std::min(color.r+tr-1,255);
+            int gl = std::max(color.g-tg+1,0), gh = std::min(color.g+tg-1,255);
+            int bl = std::max(color.b-tb+1,0), bh = std::min(color.b+tb-1,255);
+            int y, u, v, unused;
+            fromRgb(rl,gl,bl,y,unused,unused);
+            this->lo[0] = clamp(y-1);
+            fromRgb(rh,gh,bh,y,unused,unused);
+            this->hi[0] = clamp(y+1);
+            fromRgb(rh,gh,bl,unused,u,unused);
+            this->lo[1] = clamp(u-1);
+            fromRgb(rl,gl,bh,unused,u,unused);
+            this->hi[1] = clamp(u+1);
+            fromRgb(rl,gh,bh,unused,unused,v);
+            this->lo[2] = clamp(v-1);
+            fromRgb(rh,gl,bl,unused,unused,v);
+            this->hi[2] = clamp(v+1);
+        }
+        bool test(uint8_t y, uint8_t u, uint8_t v) const {
+            return !this->empty && y >= this->lo[0] && y <= this->hi[0] && u >= this->lo[1] && u <= this->hi[1]
+                && v >= this->lo[2] && v <= this->hi[2];
+        }
+    private:
+        static uint8_t clamp(int c){
+            return (uint8_t)std::clamp(c,0,255);
+        }
+    };
+
+#if defined(__AVX2__)
+    // Y of 32 pixels from an even x, and the 16 UV pairs under them
+    inline void load32(const Frame &frame, uint32_t x, uint32_t y, __m256i &luma, __m256i &uv){
+        if(frame.format == NV12){
+            luma = _mm256_loadu_si256((const __m256i*)(frame.luma + y*frame.lumaStride + x));
+            uv = _mm256_loadu_si256((const __m256i*)(frame.chroma + (y >> 1)*frame.chromaStride + x));
+            return;
+        }
+        // Even bytes are Y, odd ones U and V, packed into the NV12 layout. packus works per 128 bit
+        // half, the permute puts the quarters back in order.
+        const uint8_t *row = frame.luma + y*frame.lumaStride + 2*x;
+        __m256i a = _mm256_loadu_si256((const __m256i*)row), b = _mm256_loadu_si256((const __m256i*)(row+32));
+        const __m256i low = _mm256_set1_epi16(0x00ff);
+        luma = _mm256_permute4x64_epi64(_mm256_packus_epi16(_mm256_and_si256(a,low),_mm256_and_si256(b,low)),0xd8);
+        uv = _mm256_permute4x64_epi64(_mm256_packus_epi16(_mm256_srli_epi16(a,8),_mm256_srli_epi16(b,8)),0xd8);
+    }
+    inline uint32_t match32(__m256i luma, __m256i uv, const Range &range){
+        if(range.empty){
+            return 0;
+        }
+        auto inside = [](__m256i v, __m256i lo, __m256i hi){
+            return _mm256_and_si256(_mm256_cmpeq_epi8(_mm256_max_epu8(v,lo),v),_mm256_cmpeq_epi8(_mm256_min_epu8(v,hi),v));
+        };
+        __m256i lumaOk = inside(luma,_mm256_set1_epi8((char)range.lo[0]),_mm256_set1_epi8((char)range.hi[0]));
+        __m256i uvOk = inside(uv,_mm256_set1_epi16((int16_t)(range.lo[1] | range.lo[2] << 8)),_mm256_set1_epi16((int16_t)(range.hi[1] | range.hi[2] << 8)));
+        // A UV pair covers the two pixels under its two bytes, so both bytes of the pair have to
+        // be inside
+        uvOk = _mm256_cmpeq_epi16(uvOk,_mm256_set1_epi8(-1));
+        return _mm256_movemask_epi8(_mm256_and_si256(lumaOk,uvOk));
+    }
+#endif
+
+    // Bit i set if pixel x+i of row y is inside the range, for 32 pixels from an even x
+    inline uint32_t match32(const Frame &frame, uint32_t x, uint32_t y, const Range &range){
+#if defined(__AVX2__)
+        __m256i luma, uv;
+        load32(frame,x,y,luma,uv);
+        return match32(luma,uv,range);
+#else
+        uint32_t res = 0;
+        for(uint32_t i=0;i<32;++i){
+            uint8_t py, pu, pv;
+            frame.pixel(x+i,y,py,pu,pv);
+            res |= (uint32_t)range.test(py,pu,pv) << i;
+        }
+        return res;
+#endif
+    }
+
+    // Pixels of a frame for analysis::Analyzer, the counterpart of its RGBA source. Rows are
+    // classified from even columns only.
+    struct Source{
+        const Frame &frame;
+        const Range &borderRange, &padRange;
+
+        bool test(uint32_t x, uint32_t y, const Range &range) const {
+            uint8_t py, pu, pv;
+            this->frame.pixel(x,y,py,pu,pv);
+            return range.test(py,pu,pv);
+        }
+        // Border and pad mask words of [begin,end) of row y, begin even
+        void classify(uint32_t y, uint32_t begin, uint32_t end, uint64_t *b, uint64_t *p) const {
+            uint32_t x = begin;
+            for(;x+64<=end;x+=64){
+#if defined(__AVX2__)
+                // Loaded once for both ranges
+                __m256i luma, uv;
+                load32(this->frame,x,y,luma,uv);
+                uint64_t wb = match32(luma,uv,this->borderRange), wp = match32(luma,uv,this->padRange);
+                load32(this->frame,x+32,y,luma,uv);
+                *b++ = wb | (uint64_t)match32(luma,uv,this->borderRange) << 32;
+                *p++ = wp | (uint64_t)match32(luma,uv,this->padRange) << 32;
+#else
+                *b++ = match32(this->frame,x,y,this->borderRange) | (uint64_t)match32(this->frame,x+32,y,this->borderRange) << 32;
+                *p++ = match32(this->frame,x,y,this->padRange) | (uint64_t)match32(this->frame,x+32,y,this->padRange) << 32;
+#endif
+            }
+            if(x < end){
+                uint64_t wb = 0, wp = 0;
+                for(uint32_t i=0;x+i<end;++i){
+                    wb |= (uint64_t)this->test(x+i,y,this->borderRange) << i;
+                    wp |= (uint64_t)this->test(x+i,y,this->padRange) << i;
+                }
+                *b = wb;
+                *p = wp;
+            }
+        }
+        // First border pixel of [begin,end) in row y, or end. begin is even.
+        uint32_t first(uint32_t y, uint32_t begin, uint32_t end) const {
+            uint32_t x = begin;
+            for(;x+32<=end;x+=32){
+                uint32_t m = match32(this->frame,x,y,this->borderRange);
+                if(m){
+                    return x + __builtin_ctz(m);
+                }
+            }
+            for(;x<end;++x){
+                if(this->test(x,y,this->borderRange)){
+                    return x;
+                }
+            }
+            return end;
+        }
+        // Last border pixel of [begin,end) in row y, or end
+        uint32_t last(uint32_t y, uint32_t begin, uint32_t end) const {
+            uint32_t x = end;
+            if((x & 1) && x > begin){
+                if(this->test(--x,y,this->borderRange)){
+                    return x;
+                }
+            }
+            for(;x>=begin+32;x-=32){
+                uint32_t m = match32(this->frame,x-32,y,this->borderRange);
+                if(m){
+                    return x - 32 + 31 - __builtin_clz(m);
+                }
+            }
+            while(x>begin){
+                --x;
+                if(this->test(x,y,this->borderRange)){
+                    return x;
+                }
+            }
+            return end;
+        }
+    };
+}
@@ -0,0 +1,511 @@
+#include <iostream>
+#include <fstream>
+#include <cstdint>
+#include <chrono>
+#include <string>
+#include <vector>
+#include <algorithm>
+#include <thread>
+#include <atomic>
+#include <random>
+
+#include "glm.hpp"
+
+#include "image.h"
+#include "camera.h"
+#include "scene.h"
+#include "raster.h"
+#include "detector.h"
+#include "analysis.h"
+#include "moments.h"
+#include "yuv.h"
+#include "thread_pool.h"
+#include "service.h"
+
+// Times every stage of the detection pipeline on software rendered frames with known poses
+// and writes the results as JSON so runs can be compared.
+
+typedef std::chrono::steady_clock timer;
+
+constexpr uint32_t SIZE = 950;
+constexpr int REPEATS = 20;
+constexpr int ENGINES = 4;
+
+struct pose{
+    float distance;
+    double yaw, pitch;
+};
+
+struct series{
+    std::string name;
+    std::vector<double> times;
+    std::vector<double> errors;
+    int failures = 0;
+    void add(timer::time_point t0, timer::time_point t1){
+        this->times.push_back(std::chrono::duration<double,std::micro>(t1-t0).count());
+    }
+    double percentile(double q){
+        if(this->times.empty()){
+            return 0.0;
+        }
+        std::vector<double> sorted = this->times;
+        std::sort(sorted.begin(),sorted.end());
+        return sorted[std::min(sorted.size()-1,(size_t)(q*sorted.size()))];
+    }
+    double mean(const std::vector<double> &v){
+        double sum = 0.0;
+        for(double d : v){
+            sum += d;
+        }
+        return v.empty() ? 0.0 : sum/v.size();
+    }
+    void write(std::ostream &out){
+        out << "{\"name\":\"" << this->name << "\",\"count\":" << this->times.size()
+            << ",\"mean_us\":" << this->mean(this->times) << ",\"p50_us\":" << this->percentile(0.5) << ",\"p99_us\":" << this->percentile(0.99)
+            << ",\"throughput_fps\":" << (this->times.empty() ? 0.0 : 1e6/this->mean(this->times));
+        if(!this->errors.empty() || this->failures){
+            double maxError = this->errors.empty() ? 0.0 : *std::max_element(this->errors.begin(),this->errors.end());
+            out << ",\"mean_error\":" << this->mean(this->errors) << ",\"max_error\":" << maxError << ",\"failures\":" << this->failures;
+        }
+        out << "}";
+    }
+};
+
+enum Stage{
+    BOUNDS, ROI, LINEAR_SEARCH_TOP, X_DIR_OF_MAX, TRACE_MAJOR1, LINEAR_SEARCH_MAJOR2, TRACE_MAJOR2, TRACE_MAJOR1_REFINE, TRACE_MAJOR1_CONST, DISTANCE, STAGE_COUNT
+};
+const char *stageNames[STAGE_COUNT] = {
+    "bounds", "roi", "linearSearch_top", "xDirOfMax", "traceBorder_major1", "linearSearch_major2", "traceBorder_major2", "traceBorder_major1_refine", "traceBorder_major1_const", "distance"
+};
+
+// The full frame TRACE pipeline from Detector, one timed call per stage
+class StagedTrace{
+public:
+    series stages[STAGE_COUNT];
+    // The moments estimate on the same masks, the alternative to every stage after bounds
+    series moments;
+    // Runs where the compile time matcher ended the refine walk somewhere else than the mask
+    int constMismatches = 0;
+    StagedTrace(ThreadPool *pool)
+        : analyzer(pool), accumulator(pool),
+        borderRange(BORDER_COLOR,TOLERANCE,TOLERANCE,TOLERANCE),
+        padRange(PAD_COLOR,TOLERANCE,TOLERANCE,TOLERANCE){
+        for(int i=0;i<STAGE_COUNT;++i){
+            this->stages[i].name = stageNames[i];
+        }
+        this->moments.name = "moments";
+    }
+    // Distance from the moments of the masks the last run found
+    bool estimate(double &calculatedDistance){
+        if(!this->analysed.found){
+            return false;
+        }
+        timer::time_point t0 = timer::now();
+        moments::sums sums;
+        moments::ellipse shape;
+        this->accumulator.run(this->borderMask,this->padMask,this->analysed.extent,sums);
+        bool ok = moments::fit(sums,shape);
+        if(ok){
+            calculatedDistance = ((double)SIZE/(2.0*shape.a)) / std::tan(0.5*FOV);
+        }
+        this->moments.add(t0,timer::now());
+        return ok;
+    }
+    bool run(const rgba *pixels, double &calculatedDistance){
+        timer::time_point t0 = timer::now();
+        this->analyzer.run(pixels,SIZE,{{0,0},{SIZE-1,SIZE-1}},this->borderRange,this->padRange,&this->borderMask,&this->padMask,this->analysed);
+        timer::time_point t1 = timer::now();
+        this->stages[BOUNDS].add(t0,t1);
+        if(!this->analysed.found){
+            return false;
+        }
+        point min = this->analysed.extent.min, max = this->analysed.extent.max;
+        uint32_t dx = max.x-min.x, dy = max.y-min.y;
+        if(dx == 0 || dy == 0){
+            return false;
+        }
+
+        t0 = timer::now();
+        ImageView padSection = ImageView(pixels,min,max,SIZE);
+        t1 = timer::now();
+        this->stages[ROI].add(t0,t1);
+
+        point centerTop;
+        t0 = timer::now();
+        bool ok = padSection.linearSearch({dx/2,0},{0,1},centerTop,this->padMask,annotate::None{});
+        t1 = timer::now();
+        this->stages[LINEAR_SEARCH_TOP].add(t0,t1);
+        if(!ok){return false;}
+
+        bool rMajor;
+        t0 = timer::now();
+        ok = padSection.xDirOfMax(centerTop,rMajor,this->padMask,this->borderMask,annotate::None{});
+        t1 = timer::now();
+        this->stages[X_DIR_OF_MAX].add(t0,t1);
+        if(!ok){return false;}
+
+        point center = {dx/2,dy/2};
+        float radiusSquared;
+        point major1;
+        int checkCount = (padSection.width+padSection.height)/20;
+        t0 = timer::now();
+        ok = padSection.traceBorder(centerTop,center,rMajor,false,checkCount,major1,radiusSquared,this->borderMask,annotate::None{});
+        t1 = timer::now();
+        this->stages[TRACE_MAJOR1].add(t0,t1);
+        if(!ok){return false;}
+
+        point major2Guess = {dx-major1.x,dy-major1.y};
+        direction c_m1 = major1-center;
+        point major2Guess2;
+        t0 = timer::now();
+        ok = padSection.linearSearch(major2Guess,{c_m1.dx>0?1:-1,c_m1.dy>0?1:-1},major2Guess2,this->padMask,annotate::None{});
+        t1 = timer::now();
+        this->stages[LINEAR_SEARCH_MAJOR2].add(t0,t1);
+        if(!ok){return false;}
+
+        point major2;
+        float r2Squared;
+        t0 = timer::now();
+        ok = padSection.traceBorder(major2Guess2,major1,!rMajor,false,checkCount,major2,r2Squared,this->borderMask,annotate::None{});
+        t1 = timer::now();
+        this->stages[TRACE_MAJOR2].add(t0,t1);
+        if(!ok){return false;}
+
+        // The refine walk again on the pixels themselves, with the border colour folded in at
+        // compile time. The mask is built with the same tolerances, so both have to agree.
+        point constMajor1 = {0,0};
+        float constRadiusSquared;
+        t0 = timer::now();
+        bool constOk = padSection.traceBorder(major1,major2,rMajor,false,checkCount,constMajor1,constRadiusSquared,
+            match::Const<pack(BORDER_COLOR),TOLERANCE>{},annotate::None{});
+        t1 = timer::now();
+        this->stages[TRACE_MAJOR1_CONST].add(t0,t1);
+
+        t0 = timer::now();
+        ok = padSection.traceBorder(major1,major2,rMajor,false,checkCount,major1,radiusSquared,this->borderMask,annotate::None{});
+        t1 = timer::now();
+        this->stages[TRACE_MAJOR1_REFINE].add(t0,t1);
+        if(constOk != ok || (ok && (constMajor1.x != major1.x || constMajor1.y != major1.y))){
+            ++this->constMismatches;
+        }
+        if(!ok){return false;}
+
+        t0 = timer::now();
+        calculatedDistance = ((double)SIZE/std::sqrt((major2-major1).magSq())) / std::tan(0.5*FOV);
+        t1 = timer::now();
+        this->stages[DISTANCE].add(t0,t1);
+        return true;
+    }
+private:
+    analysis::Analyzer analyzer;
+    moments::Accumulator accumulator;
+    analysis::result analysed;
+    simd::ColorRange borderRange, padRange;
+    ColorMask borderMask, padMask;
+};
+
+// Grey, neither pad nor border, over the top right quarter of the pad
+void occlude(rgba *pixels){
+    simd::ColorRange border(BORDER_COLOR,TOLERANCE,TOLERANCE,TOLERANCE);
+    bounds::box extent;
+    if(!bounds::find(pixels,SIZE,SIZE,SIZE,border,extent)){
+        return;
+    }
+    uint32_t cx = (extent.min.x+extent.max.x)/2, cy = (extent.min.y+extent.max.y)/2;
+    for(uint32_t y=extent.min.y;y<=cy;++y){
+        for(uint32_t x=cx+(extent.max.x-cx)/2;x<=extent.max.x;++x){
+            pixels[y*SIZE+x] = {200,200,200,255};
+        }
+    }
+}
+// One pixel in twenty turned grey
+void speckle(rgba *pixels, std::mt19937 &rng){
+    for(uint32_t i=0;i<SIZE*SIZE/20;++i){
+        pixels[rng()%(SIZE*SIZE)] = {200,200,200,255};
+    }
+}
+
+// What a camera would deliver for the frame, chroma averaged over 2x2 pixels
+void toNv12(const rgba *pixels, std::vector<uint8_t> &res){
+    res.resize(SIZE*SIZE*3/2);
+    uint8_t *uv = res.data()+SIZE*SIZE;
+    for(uint32_t y=0;y<SIZE;y+=2){
+        for(uint32_t x=0;x<SIZE;x+=2){
+            int r = 0, g = 0, b = 0;
+            for(uint32_t i=0;i<4;++i){
+                const rgba &p = pixels[(y+i/2)*SIZE+x+i%2];
+                int py, unused;
+                yuv::fromRgb(p.r,p.g,p.b,py,unused,unused);
+                res[(y+i/2)*SIZE+x+i%2] = py;
+                r += p.r;
+                g += p.g;
+                b += p.b;
+            }
+            int unused, u, v;
+            yuv::fromRgb((r+2)/4,(g+2)/4,(b+2)/4,unused,u,v);
+            uv[(y/2)*SIZE+x] = u;
+            uv[(y/2)*SIZE+x+1] = v;
+        }
+    }
+}
+
+void render(raster::Rasterizer &rasterizer, const raster::Texture &texture, const pose &p, rgba *pixels, double &lenActual){
+    glm::vec3 pos = camera::orbit(p.distance,p.yaw,p.pitch);
+    glm::mat4 vp = camera::viewProjection(pos,p.yaw,p.pitch,FOV,(float)SIZE / (float)SIZE);
+    rasterizer.render(scene::quad,scene::quadIndices,6,scene::model(),vp,texture,pixels);
+    lenActual = glm::length(pos);
+}
+
+int main(int argc, char **argv){
+    std::string outName = argc > 1 ? argv[1] : "benchmark.json";
+
+    ThreadPool pool;
+    raster::Texture texture(2048,2048);
+    scene::padTexture(texture,&pool);
+    raster::Rasterizer rasterizer(SIZE,SIZE,&pool);
+    rgba *pixels = new rgba[SIZE*SIZE];
+
+    std::vector<pose> poses;
+    for(float distance : {1.5f,2.0f,3.0f,5.0f,8.0f,12.0f,20.0f,30.0f}){
+        for(double pitch : {1.5707963,1.3,1.0,0.7}){
+            for(double yaw : {0.0,0.8}){
+                poses.push_back({distance,yaw,pitch});
+            }
+        }
+    }
+
+    StagedTrace staged(&pool);
+    const char *engineNames[ENGINES] = {"trace","fit","fit_edges","correlate"};
+    series engines[ENGINES];
+    for(int e=0;e<ENGINES;++e){
+        engines[e].name = engineNames[e];
+    }
+    detector::Detector detectors[ENGINES] = {
+        detector::Detector({PAD_COLOR,BORDER_COLOR,TOLERANCE,FOV,detector::TRACE},&pool),
+        detector::Detector({PAD_COLOR,BORDER_COLOR,TOLERANCE,FOV,detector::FIT},&pool),
+        detector::Detector({PAD_COLOR,BORDER_COLOR,TOLERANCE,FOV,detector::FIT,2,true},&pool),
+        detector::Detector({PAD_COLOR,BORDER_COLOR,TOLERANCE,FOV,detector::CORRELATE},&pool)
+    };
+    // FIT straight on NV12, the conversion is left out of the time like a camera would leave it out
+    series nv12, nv12Tracked;
+    nv12.name = "fit_nv12";
+    nv12Tracked.name = "fit_nv12_tracked";
+    detector::Detector nv12Detector({PAD_COLOR,BORDER_COLOR,TOLERANCE,FOV,detector::FIT},&pool);
+    std::vector<uint8_t> nv12Pixels;
+    yuv::Frame nv12Frame = yuv::Frame::nv12(nv12Pixels.data(),SIZE,SIZE,SIZE);
+    std::ofstream out(outName);
+    out << "{\"version\":1,\"frame\":[" << SIZE << "," << SIZE << "],\"threads\":" << pool.size() << ",\"poses\":[";
+
+    for(size_t i=0;i<poses.size();++i){
+        const pose &p = poses[i];
+        double lenActual;
+        render(rasterizer,texture,p,pixels,lenActual);
+
+        double calculated[ENGINES] = {};
+        double fromMoments = 0.0;
+        bool measured = false;
+        for(int r=0;r<REPEATS;++r){
+            staged.run(pixels,calculated[0]);
+            measured = staged.estimate(fromMoments);
+        }
+        if(measured){
+            staged.moments.errors.push_back(std::abs(fromMoments-lenActual)/lenActual);
+        }else{
+            ++staged.moments.failures;
+        }
+        for(int e=0;e<ENGINES;++e){
+            detector::Detection detection;
+            for(int r=0;r<REPEATS;++r){
+                // Every repeat is a cold search, tracking is measured separately below
+                detectors[e].tracker.lose();
+                timer::time_point t0 = timer::now();
+                detection = detectors[e].detect(pixels,SIZE,SIZE,SIZE);
+                engines[e].add(t0,timer::now());
+            }
+            calculated[e] = detection.calculatedDistance;
+            if(detection.accuracy == detector::BORDER){
+                engines[e].errors.push_back(std::abs(detection.calculatedDistance-lenActual)/lenActual);
+            }else{
+                ++engines[e].failures;
+            }
+        }
+        toNv12(pixels,nv12Pixels);
+        nv12Frame = yuv::Frame::nv12(nv12Pixels.data(),SIZE,SIZE,SIZE);
+        detector::Detection fromNv12;
+        for(int r=0;r<REPEATS;++r){
+            nv12Detector.tracker.lose();
+            timer::time_point t0 = timer::now();
+            fromNv12 = nv12Detector.detect(nv12Frame);
+            nv12.add(t0,timer::now());
+        }
+        if(fromNv12.accuracy == detector::BORDER){
+            nv12.errors.push_back(std::abs(fromNv12.calculatedDistance-lenActual)/lenActual);
+        }else{
+            ++nv12.failures;
+        }
+        out << (i ? "," : "") << "{\"distance\":" << p.distance << ",\"pitch\":" << p.pitch << ",\"yaw\":" << p.yaw
+            << ",\"actual\":" << lenActual;
+        for(int e=0;e<ENGINES;++e){
+            out << ",\"" << engineNames[e] << "\":" << calculated[e];
+        }
+        out << ",\"moments\":" << fromMoments << ",\"fit_nv12\":" << fromNv12.calculatedDistance << "}";
+    }
+
+    // The same poses with part of the pad covered, and with noise over the whole frame, where
+    // walking the border is least reliable
+    series occluded[ENGINES], noisy[ENGINES];
+    std::mt19937 rng(1);
+    for(int d=0;d<2;++d){
+        series *degraded = d ? noisy : occluded;
+        for(int e=0;e<ENGINES;++e){
+            degraded[e].name = std::string(engineNames[e]) + (d ? "_noisy" : "_occluded");
+        }
+        for(const pose &p : poses){
+            double lenActual;
+            render(rasterizer,texture,p,pixels,lenActual);
+            if(d){
+                speckle(pixels,rng);
+            }else{
+                occlude(pixels);
+            }
+            for(int e=0;e<ENGINES;++e){
+                detectors[e].tracker.lose();
+                timer::time_point t0 = timer::now();
+                detector::Detection detection = detectors[e].detect(pixels,SIZE,SIZE,SIZE);
+                degraded[e].add(t0,timer::now());
+                if(detection.accuracy == detector::BORDER){
+                    degraded[e].errors.push_back(std::abs(detection.calculatedDistance-lenActual)/lenActual);
+                }else{
+                    ++degraded[e].failures;
+                }
+            }
+        }
+    }
+
+    // A smooth flight where the tracker can follow the pad
+    series tracked[ENGINES];
+    for(int e=0;e<ENGINES;++e){
+        tracked[e].name = std::string(engineNames[e]) + "_tracked";
+        detectors[e].tracker.lose();
+    }
+    nv12Detector.tracker.lose();
+    for(int i=0;i<300;++i){
+        pose p = {2.0f + 10.0f*i/300.0f,0.3*std::sin(i*0.01),1.1 + 0.3*std::sin(i*0.02)};
+        double lenActual;
+        render(rasterizer,texture,p,pixels,lenActual);
+        for(int e=0;e<ENGINES;++e){
+            timer::time_point t0 = timer::now();
+            detector::Detection detection = detectors[e].detect(pixels,SIZE,SIZE,SIZE);
+            tracked[e].add(t0,timer::now());
+            if(detection.accuracy == detector::BORDER){
+                tracked[e].errors.push_back(std::abs(detection.calculatedDistance-lenActual)/lenActual);
+            }else{
+                ++tracked[e].failures;
+            }
+        }
+        toNv12(pixels,nv12Pixels);
+        nv12Frame = yuv::Frame::nv12(nv12Pixels.data(),SIZE,SIZE,SIZE);
+        timer::time_point t0 = timer::now();
+        detector::Detection detection = nv12Detector.detect(nv12Frame);
+        nv12Tracked.add(t0,timer::now());
+        if(detection.accuracy == detector::BORDER){
+            nv12Tracked.errors.push_back(std::abs(detection.calculatedDistance-lenActual)/lenActual);
+        }else{
+            ++nv12Tracked.failures;
+        }
+    }
+
+    // Several independent flights through the service, with one producer thread per stream like
+    // one capture thread per camera. Frames/s counts handled frames, dropped ones are reported apart.
+    constexpr uint32_t STREAMS = 8, FLIGHT = 16, PASSES = 8;
+    std::vector<std::vector<rgba>> flight(FLIGHT,std::vector<rgba>(SIZE*SIZE));
+    for(uint32_t i=0;i<FLIGHT;++i){
+        pose p = {2.0f + 6.0f*i/FLIGHT,0.3,1.1 + 0.3*i/FLIGHT};
+        double lenActual;
+        render(rasterizer,texture,p,flight[i].data(),lenActual);
+    }
+    struct serviceRun{
+        unsigned int threads;
+        double fps;
+        uint64_t dropped;
+    };
+    std::vector<serviceRun> serviceRuns;
+    unsigned int cores = std::max(1u,std::thread::hardware_concurrency());
+    for(unsigned int threads=1;;threads=std::min(2*threads,cores)){
+        std::atomic<uint64_t> handled{0};
+        service::Service svc({PAD_COLOR,BORDER_COLOR,TOLERANCE,FOV,detector::TRACE},STREAMS,SIZE,SIZE,
+            [&](const service::Result&){handled.fetch_add(1,std::memory_order_relaxed);},threads);
+        timer::time_point t0 = timer::now();
+        std::vector<std::thread> producers;
+        for(uint32_t s=0;s<STREAMS;++s){
+            producers.emplace_back([&,s]{
+                for(uint32_t i=0;i<PASSES*FLIGHT;++i){
+                    // Each stream flies the same path from a different point, out and back
+                    uint32_t k = (i+2*s) % (2*FLIGHT);
+                    svc.submit(s,flight[k < FLIGHT ? k : 2*FLIGHT-1-k].data(),SIZE);
+                }
+            });
+        }
+        for(std::thread &t : producers){
+            t.join();
+        }
+        svc.drain();
+        double seconds = std::chrono::duration<double>(timer::now()-t0).count();
+        uint64_t dropped = 0;
+        for(uint32_t s=0;s<STREAMS;++s){
+            dropped += svc.dropped(s);
+        }
+        serviceRuns.push_back({threads,handled.load()/seconds,dropped});
+        if(threads == cores){
+            break;
+        }
+    }
+
+    out << "],\"stages\":[";
+    for(int i=0;i<STAGE_COUNT;++i){
+        out << (i ? "," : "");
+        staged.stages[i].write(out);
+    }
+    std::vector<series*> results = {&staged.moments};
+    for(series *group : {engines,tracked,occluded,noisy}){
+        for(int e=0;e<ENGINES;++e){
+            results.push_back(&group[e]);
+        }
+    }
+    results.push_back(&nv12);
+    results.push_back(&nv12Tracked);
+    out << "],\"engines\":[";
+    for(size_t i=0;i<results.size();++i){
+        out << (i ? "," : "");
+        results[i]->write(out);
+    }
+    out << "],\"service\":[";
+    for(size_t i=0;i<serviceRuns.size();++i){
+        out << (i ? "," : "") << "{\"threads\":" << serviceRuns[i].threads << ",\"streams\":" << STREAMS
+            << ",\"throughput_fps\":" << serviceRuns[i].fps << ",\"dropped\":" << serviceRuns[i].dropped << "}";
+    }
+    out << "]}" << std::endl;
+
+    std::cout << "stage                       p50 us    p99 us" << std::endl;
+    for(int i=0;i<STAGE_COUNT;++i){
+        series &s = staged.stages[i];
+        std::cout << s.name << std::string(26-s.name.size(),' ') << s.percentile(0.5) << "\t" << s.percentile(0.99) << std::endl;
+    }
+    std::cout << std::endl << "engine                      p50 us    p99 us    frames/s  mean error  failures" << std::endl;
+    for(series *s : results){
+        std::cout << s->name << std::string(26-s->name.size(),' ') << s->percentile(0.5) << "\t" << s->percentile(0.99) << "\t" << 1e6/s->mean(s->times)
+            << "\t" << s->mean(s->errors) << "\t" << s->failures << std::endl;
+    }
+    std::cout << std::endl << "service threads  frames/s  speedup  dropped" << std::endl;
+    for(const serviceRun &r : serviceRuns){
+        std::cout << r.threads << "\t\t" << r.fps << "\t" << r.fps/serviceRuns[0].fps << "\t" << r.dropped << std::endl;
+    }
+    std::cout << "Results written to " << outName << std::endl;
+
+    delete[] pixels;
+    if(staged.constMismatches){
+        std::cerr << "match::Const disagreed with the border mask in " << staged.constMismatches << " runs" << std::endl;
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,113 @@
+#include <iostream>
+#include <cstdint>
+#include <chrono>
+#include <string>
+#include <vector>
+#include <cmath>
+
+#include "glm.hpp"
+
+#include "image.h"
+#include "camera.h"
+#include "scene.h"
+#include "raster.h"
+#include "detector.h"
+#include "thread_pool.h"
+#include "profiler.h"
+#include "arena.h"
+#include "alloc_check.h"
+
+// Runs the detector on frames from the software renderer, no window or GPU needed
+int main(int argc, char **argv){
+    int frames = argc > 1 ? std::stoi(argv[1]) : 200;
+    std::string engineName = argc > 2 ? argv[2] : "trace";
+    detector::Engine engine = engineName == "fit" ? detector::FIT : engineName == "correlate" ? detector::CORRELATE : detector::TRACE;
+
+    ThreadPool pool;
+    MappedFile cached;
+    bool hit = scene::cachedPadTexture(2048,2048,"cache",cached,&pool);
+    raster::Texture texture = hit ? raster::Texture(std::move(cached),texcache::HEADER_SIZE,2048,2048) : raster::Texture(2048,2048);
+    if(!hit){
+        scene::padTexture(texture,&pool);
+    }
+
+    raster::Rasterizer rasterizer(950,950,&pool);
+    Arena frameArena;
+    detector::Detector padDetector = detector::Detector({PAD_COLOR,BORDER_COLOR,TOLERANCE,FOV,engine},&pool,&frameArena);
+    rgba *pixels = new rgba[950*950];
+
+    for(float distance : {1.5f,2.0f,3.0f,5.0f,8.0f,12.0f,20.0f}){
+        for(double pitch : {1.57,1.2,0.9}){
+            glm::vec3 pos = camera::orbit(distance,0.3,pitch);
+            glm::mat4 vp = camera::viewProjection(pos,0.3,pitch,FOV,(float)950 / (float)950);
+            frameArena.reset();
+            rasterizer.render(scene::quad,scene::quadIndices,6,scene::model(),vp,texture,pixels);
+            detector::Detection detection = padDetector.detect(pixels,950,950,950);
+            detector::print(detection,glm::length(pos));
+        }
+    }
+
+    // Two pads side by side, each cut from a frame of its own, for detectAll. Shifting a pad
+    // sideways keeps its size in pixels, so each should come out at its own distance, within the
+    // border trace's error of about 7% straight down.
+    int failed = 0;
+    {
+        const float distances[2] = {8.0f,12.0f};
+        rgba *halves = new rgba[2*950*950];
+        for(int i=0;i<2;++i){
+            glm::vec3 pos = camera::orbit(distances[i],0.0,1.5707963);
+            glm::mat4 vp = camera::viewProjection(pos,0.0,1.5707963,FOV,(float)950 / (float)950);
+            rasterizer.render(scene::quad,scene::quadIndices,6,scene::model(),vp,texture,halves+i*950*950);
+        }
+        for(uint32_t y=0;y<950;++y){
+            for(uint32_t x=0;x<950;++x){
+                pixels[y*950+x] = x < 475 ? halves[y*950+x+237] : halves[950*950+y*950+x-238];
+            }
+        }
+        delete[] halves;
+        frameArena.reset();
+        std::vector<detector::Detection> pads = padDetector.detectAll(pixels,950,950,950);
+        for(const detector::Detection &detection : pads){
+            double actual = distances[detection.extent.min.x < 475 ? 0 : 1];
+            detector::print(detection,actual);
+            if(detection.accuracy != detector::BORDER || std::abs(detection.calculatedDistance-actual) > 0.1*actual){
+                failed = 1;
+            }
+        }
+        if(pads.size() != 2){
+            failed = 1;
+        }
+        if(failed){
+            std::cerr << "detectAll: expected both pads within 10% of their distance" << std::endl;
+        }
+    }
+
+    typedef std::chrono::steady_clock clock;
+    double renderTime = 0, detectTime = 0;
+    for(int i=0;i<frames;++i){
+        frameArena.reset();
+        // The frames above went through every path, nothing here may allocate or spill out of the
+        // frame arena
+        alloc_check::Scope steady(true,&frameArena);
+        double pitch = 0.9 + 0.6*i/frames;
+        glm::vec3 pos = camera::orbit(2.0f + 10.0f*i/frames,0.3,pitch);
+        glm::mat4 vp = camera::viewProjection(pos,0.3,pitch,FOV,(float)950 / (float)950);
+        clock::time_point t0 = clock::now();
+        {
+            PROFILE_SCOPE(RENDER);
+            rasterizer.render(scene::quad,scene::quadIndices,6,scene::model(),vp,texture,pixels);
+        }
+        clock::time_point t1 = clock::now();
+        padDetector.detect(pixels,950,950,950);
+        clock::time_point t2 = clock::now();
+        renderTime += std::chrono::duration<double>(t1-t0).count();
+        detectTime += std::chrono::duration<double>(t2-t1).count();
+    }
+    std::cout << "Render: " << frames/renderTime << " frames/s, detect: " << frames/detectTime << " frames/s" << std::endl;
+#ifdef LANDINGPAD_PROFILE
+    profiler::report(std::cout);
+#endif
+
+    delete[] pixels;
+    return failed;
+}
@@ -1,6 +1,9 @@
 #include <iostream>
 #include <cstdint>
 #include <filesystem>
+#include <fstream>
+#include <cstring>
+#include <memory>
 
 #include <glad/glad.h>
 #include <GLFW/glfw3.h>
@@ -13,22 +16,24 @@
 #include "graphicsLibrary/include/mesh.h"
 #include "graphicsLibrary/include/frame_buffer_object.h"
 
-#include "filters/circle.h"
-#include "filters/noise.h"
-
 #include "controls.h"
 #include "image.h"
-
-
-
-constexpr float RADIUS = 1.0f;
-constexpr rgba PAD_COLOR = rgba{0,10,150,255};
-constexpr rgba BORDER_COLOR = rgba{0,0,0,255};
-constexpr int TOLERANCE = 55;
-constexpr float FOV = 3.1415926f*0.5f;
-
-
-int main(){
+#include "camera.h"
+#include "scene.h"
+#include "detector.h"
+#include "thread_pool.h"
+#include "profiler.h"
+#include "telemetry.h"
+#include "recording.h"
+#include "snapshot.h"
+#include "arena.h"
+#include "alloc_check.h"
+
+
+// Usage: main.exe [--telemetry file] [--record file] [--snapshots png|qoi|tga]
+// Results go to stdout as text, or to the given file as binary telemetry records. Recorded flights
+// can be run again with replay.exe. Snapshots taken with key 1 go to snapshots/, numbered.
+int main(int argc, char **argv){
     if(!glfwInit()){
         throw std::runtime_error("Failed to initialize GLFW");
         return EXIT_FAILURE;
@@ -57,9 +62,16 @@ int main(){
     glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
 
     graphics::Shader shader("texture");
+    ThreadPool pool;
     graphics::Image image(2048,2048);
-    filter::circle(image, PAD_COLOR, rgba{0,0,0,255}, 475, true, rgba{0,0,0,0});
-    filter::noise(image, rgba{25,25,25,0});
+    MappedFile cached;
+    if(scene::cachedPadTexture(2048,2048,"cache",cached,&pool)){
+        // graphics::Image owns its buffer, so the cached texels are copied in
+        memcpy(image.buffer,texcache::pixels(cached),4*2048*2048);
+        cached.close();
+    }else{
+        scene::padTexture(image,&pool);
+    }
     graphics::Texture texture(image);
 
     graphics::Renderable renderable = graphics::Renderable();
@@ -72,24 +84,10 @@ int main(){
     renderable.setVBOLayout(layout);
 
     typedef graphics::Mesh<GLuint> Mesh_t;
-    struct vertex{
-        GLfloat pos[3];
-        GLushort texCoords[2];
-    };
-
-    vertex positions[4] = {
-        {{-RADIUS,-RADIUS,0.0f},       {0,0}},
-        {{RADIUS,RADIUS,0.0f},   {65535,65535}},
-        {{RADIUS,-RADIUS,0.0f},     {65535,0}},
-        {{-RADIUS,RADIUS,0.0f},     {0,65535}}
-    };
-    GLuint indices[6] = {
-        2,1,0,
-        0,1,3
-    };
+    typedef raster::Vertex vertex;
 
     Mesh_t mesh = Mesh_t(sizeof(vertex)/4);
-    mesh.add(positions,indices,4,6);
+    mesh.add(scene::quad,scene::quadIndices,4,6);
 
     renderable.loadVertexData(mesh.getVertices(), mesh.getVertexCount()*sizeof(vertex));
     renderable.loadIndexData(mesh.getIndices(), mesh.getIndexCount());
@@ -98,9 +96,35 @@ int main(){
 
     graphics::FBO frameBuffer = graphics::FBO(950,950);
 
-    rgba *pixels = new rgba[950*950*4];
+    rgba *pixels = new rgba[950*950];
+    // Scratch for everything done with one frame, handed back at the top of the next
+    Arena frameArena;
+    detector::Detector padDetector = detector::Detector({PAD_COLOR,BORDER_COLOR,TOLERANCE,FOV},&pool,&frameArena);
+
+    std::ofstream telemetryFile;
+    std::unique_ptr<recording::Recorder> recorder;
+    snapshot::Format snapshotFormat = snapshot::PNG;
+    for(int i=1;i+1<argc;i+=2){
+        if(strcmp(argv[i],"--telemetry") == 0){
+            telemetryFile.open(argv[i+1],std::ios::binary);
+        }else if(strcmp(argv[i],"--record") == 0){
+            recorder = std::make_unique<recording::Recorder>(argv[i+1],950,950);
+            if(!recorder->good()){
+                std::cerr << "Cannot record to " << argv[i+1] << std::endl;
+                recorder.reset();
+            }
+        }else if(strcmp(argv[i],"--snapshots") == 0){
+            snapshotFormat = strcmp(argv[i+1],"qoi") == 0 ? snapshot::QOI : strcmp(argv[i+1],"tga") == 0 ? snapshot::TGA : snapshot::PNG;
+        }
+    }
+    snapshot::Encoder snapshots("snapshots/landing_pad",snapshotFormat);
+    padDetector.snapshots = &snapshots;
+    telemetry::Channel results = telemetryFile.is_open() ? telemetry::Channel(telemetryFile,telemetry::BINARY) : telemetry::Channel(std::cout,telemetry::TEXT);
+    uint64_t frame = 0;
 
+    bool reported = false;
     while(!glfwWindowShouldClose(window)){
+        frameArena.reset();
         glfwPollEvents();
 
         glm::vec2 forwards{-std::sin(controls::mouseX),std::cos(controls::mouseX)};
@@ -129,6 +153,7 @@ int main(){
 
 
         {
+            PROFILE_SCOPE(RENDER);
             glViewport(0,0,950,950);
 
             frameBuffer.bind();
@@ -140,10 +165,8 @@ int main(){
             glClearColor(0.0f,0.0f,0.0f,0.0f);
             glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
 
-            glm::mat4 modelMat = glm::rotate(glm::mat4(1.0f),1.57079633f,glm::vec3(1,0,0));
-            glm::mat4 viewMat = glm::rotate(glm::mat4(1.0f),(float)controls::mouseX,glm::vec3(0,1,0))*glm::rotate(glm::mat4(1.0f),(float)controls::mouseY,glm::vec3(forwards.y,0,-forwards.x))*glm::translate(glm::mat4(1.0f),pos);
-            glm::mat4 projMat = glm::perspective(FOV, (float)950 / (float)950, 0.1f, 300.0f);
-            glm::mat4 vp = projMat*viewMat;
+            glm::mat4 modelMat = scene::model();
+            glm::mat4 vp = camera::viewProjection(pos,controls::mouseX,controls::mouseY,FOV,(float)950 / (float)950);
             shader.setUniformMat4f("u_M",modelMat);
             shader.setUniformMat4f("u_VP",vp);
             renderable.render();
@@ -152,6 +175,7 @@ int main(){
         }
 
         {
+            PROFILE_SCOPE(RENDER);
             glViewport(0,0,950,950);
             shader.bind();
             frameBuffer.bindTexture(0);
@@ -171,119 +195,45 @@ int main(){
         }
 
         {
-            glReadPixels(0,0,950,950,GL_RGBA,GL_UNSIGNED_BYTE,pixels);
-
-            uint32_t maxX = 0, minX = 950, maxY = 0, minY = 0;
-            bool b = false;
-            for(int x=0;x<950 && !b;++x){
-                for(int y=0;y<950 && !b;++y){
-                    rgba col = pixels[x + y*950];
-                    if(col.equals(BORDER_COLOR,TOLERANCE,TOLERANCE,TOLERANCE)){
-                        minX = x;
-                        b = true;
-                    }
-                }
-            }
-            b = false;
-            for(int x=949;x>=0 && !b;--x){
-                for(int y=0;y<950 && !b;++y){
-                    rgba col = pixels[x + y*950];
-                    if(col.equals(BORDER_COLOR,TOLERANCE,TOLERANCE,TOLERANCE)){
-                        maxX = x;
-                        b = true;
-                    }
-                }
-            }
-            b = false;
-            for(int y=0;y<950 && !b;++y){
-                for(int x=0;x<950 && !b;++x){
-                    rgba col = pixels[x + y*950];
-                    if(col.equals(BORDER_COLOR,TOLERANCE,TOLERANCE,TOLERANCE)){
-                        minY = y;
-                        b = true;
-                    }
-                }
-            }
-            b = false;
-            for(int y=949;y>=0 && !b;--y){
-                for(int x=0;x<950 && !b;++x){
-                    rgba col = pixels[x + y*950];
-                    if(col.equals(BORDER_COLOR,TOLERANCE,TOLERANCE,TOLERANCE)){
-                        maxY = y;
-                        b = true;
-                    }
-                }
+            // From the second frame on, nothing from readback to telemetry may allocate. Frames that
+            // take a snapshot are left out, as the encoder's slots grow there to the largest pad
+            // saved so far. The encoder thread writes without allocating, so the frames after it
+            // are checked.
+            bool save = controls::controls & controls::SS;
+            alloc_check::Scope steady(frame > 0 && !save,&frameArena);
+            {
+                // Waits for the GPU, so this also covers the draws issued above
+                PROFILE_SCOPE(READBACK);
+                glReadPixels(0,0,950,950,GL_RGBA,GL_UNSIGNED_BYTE,pixels);
             }
 
-            uint32_t dx = maxX - minX;
-            uint32_t dy = maxY - minY;
-
-            double calculatedDistance = 0.0;
-            int accuracy = 0;
-
-            while(dx > 0 && dy > 0){
-                accuracy = 1;
-                Image padSection = Image(pixels,{minX,minY},{maxX,maxY}, 950);
-
-                //Find top of landing pad
-                point centerTop;
-                if(!padSection.linearSearch({dx/2,0},{0,1},centerTop,PAD_COLOR,TOLERANCE,{0,0,0,0})){break;}
-
-                //Find direction of major
-                bool rMajor;
-                if(!padSection.xDirOfMax(centerTop,rMajor,PAD_COLOR,BORDER_COLOR,TOLERANCE,{0,0,0,0})){break;}
-                    
-                //Approximate first major radius
-                point center = {dx/2,dy/2};
-                float radiusSquared;
-                point major1;
-                int checkCount = (padSection.width+padSection.height)/20;
-                if(!padSection.traceBorder(centerTop,center,rMajor,false,checkCount,major1,radiusSquared,BORDER_COLOR,TOLERANCE,{0,0,0,0})){break;}
-
-                //Approximate second major radius
-                point major2Guess = {dx-major1.x,dy-major1.y};
-
-                //Move second major radius guess onto pad
-                direction c_m1 = major1-center;
-                point major2Guess2;
-                if(!padSection.linearSearch(major2Guess,{c_m1.dx>0?1:-1,c_m1.dy>0?1:-1},major2Guess2,PAD_COLOR,TOLERANCE,{0,0,0,0})){break;}
-
-                //Find better approximation of second major radius
-                point major2;
-                float r2Squared;
-                if(!padSection.traceBorder(major2Guess2,major1,!rMajor,false,checkCount,major2,r2Squared,BORDER_COLOR,TOLERANCE,{0,0,0,0})){break;}
-
-                //Find better approximation of first major radius
-                if(!padSection.traceBorder(major1,major2,rMajor,false,checkCount,major1,radiusSquared,BORDER_COLOR,TOLERANCE,{0,0,0,0})){break;}
-
-                //Calculate major diameter
-                calculatedDistance = (950.0/std::sqrt((major2-major1).magSq())) / std::tan(0.5*FOV);
-                accuracy = 2;
-                
-                if(controls::controls & controls::SS){
-                    padSection.save("landing_pad");
-                }
-                break;
-            }
-            if(accuracy == 1){
-                calculatedDistance = (950.0/(std::max(dx,dy))) / std::tan(0.5*FOV);
-            }
+            detector::Detection detection = padDetector.detect(pixels,950,950,950,save);
             double lenActual = std::sqrt(pos.x*pos.x+pos.y*pos.y+pos.z*pos.z);
-            switch(accuracy){
-                case -1:break;
-                case 0:{
-                    std::cout << "Distance (calculated/actual): NA / " << lenActual << std::endl;
-                }break;
-                case 1:{
-                    std::cout << "Distance (calculated/actual): " << calculatedDistance << " / " << lenActual << " +-100%" << std::endl;
-                }break;
-                case 2:{
-                    std::cout << "Distance (calculated/actual): " << calculatedDistance << " / " << lenActual << std::endl;
-                }
+            float position[3] = {pos.x,pos.y,pos.z};
+            results.push(frame,detection,lenActual,position,controls::mouseX,controls::mouseY);
+            if(recorder){
+                recorder->push(frame,pixels,950,position,controls::mouseX,controls::mouseY,detection,lenActual);
             }
+            ++frame;
         }
 
+        // Report once per key press
+        if((controls::controls & controls::PROFILE) && !reported){
+            profiler::report(std::cout);
+        }
+        reported = controls::controls & controls::PROFILE;
+
         glfwSwapBuffers(window);
     }
     glfwDestroyWindow(window);
+    delete[] pixels;
+    if(results.dropped()){
+        std::cerr << results.dropped() << " telemetry records dropped" << std::endl;
+    }
+    if(recorder && recorder->dropped()){
+        std::cerr << recorder->dropped() << " frames not recorded" << std::endl;
+    }
+    if(snapshots.dropped()){
+        std::cerr << snapshots.dropped() << " snapshots dropped" << std::endl;
+    }
 }
\ No newline at end of file
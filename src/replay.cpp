@@ -0,0 +1,70 @@
+#include <iostream>
+#include <cstdint>
+#include <cmath>
+#include <chrono>
+#include <string>
+
+#include "image.h"
+#include "scene.h"
+#include "detector.h"
+#include "recording.h"
+#include "thread_pool.h"
+#include "profiler.h"
+
+// Runs the detector over a flight recorded with main.exe --record, as fast as it can and without a
+// window or GPU. Frames where the result differs from the recorded one are printed.
+// Usage: replay.exe recording [trace|fit|correlate]
+int main(int argc, char **argv){
+    if(argc < 2){
+        std::cerr << "Usage: replay.exe recording [trace|fit|correlate]" << std::endl;
+        return EXIT_FAILURE;
+    }
+    recording::Recording flight;
+    if(!flight.open(argv[1])){
+        std::cerr << "Cannot read recording " << argv[1] << std::endl;
+        return EXIT_FAILURE;
+    }
+    std::string engineName = argc > 2 ? argv[2] : "trace";
+    detector::Engine engine = engineName == "fit" ? detector::FIT : engineName == "correlate" ? detector::CORRELATE : detector::TRACE;
+
+    ThreadPool pool;
+    detector::Detector padDetector = detector::Detector({PAD_COLOR,BORDER_COLOR,TOLERANCE,FOV,engine},&pool);
+
+    typedef std::chrono::steady_clock clock;
+    double detectTime = 0;
+    size_t changed = 0, recordedFound = 0, replayedFound = 0;
+    double recordedError = 0, replayedError = 0;
+    for(size_t i=0;i<flight.size();++i){
+        const recording::FrameHeader &frame = flight.header(i);
+        clock::time_point t0 = clock::now();
+        detector::Detection detection = padDetector.detect(flight.pixels(i),frame.width,frame.height,frame.width);
+        detectTime += std::chrono::duration<double>(clock::now()-t0).count();
+
+        if(detection.accuracy != frame.accuracy || detection.calculatedDistance != frame.calculated){
+            ++changed;
+            std::cout << "Frame " << frame.frame << ": recorded " << frame.calculated << " (" << frame.accuracy << "), now "
+                << detection.calculatedDistance << " (" << detection.accuracy << "), actual " << frame.actual << '\n';
+        }
+        if(frame.accuracy == detector::BORDER){
+            ++recordedFound;
+            recordedError += std::abs(frame.calculated-frame.actual)/frame.actual;
+        }
+        if(detection.accuracy == detector::BORDER){
+            ++replayedFound;
+            replayedError += std::abs(detection.calculatedDistance-frame.actual)/frame.actual;
+        }
+    }
+    if(flight.size() == 0){
+        std::cout << "No frames recorded" << std::endl;
+        return EXIT_SUCCESS;
+    }
+    double flightTime = flight.header(flight.size()-1).timestamp*1e-9;
+    std::cout << flight.size() << " frames, " << changed << " changed" << std::endl;
+    std::cout << "Border found: " << recordedFound << " recorded, " << replayedFound << " now" << std::endl;
+    std::cout << "Mean error: " << (recordedFound ? recordedError/recordedFound : 0) << " recorded, "
+        << (replayedFound ? replayedError/replayedFound : 0) << " now" << std::endl;
+    std::cout << "Detect: " << flight.size()/detectTime << " frames/s, " << flightTime/detectTime << "x real time" << std::endl;
+#ifdef LANDINGPAD_PROFILE
+    profiler::report(std::cout);
+#endif
+}